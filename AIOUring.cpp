@@ -4,181 +4,1963 @@
 
 #include "include/aiouring/AIOUring.h"
 
+#include <unistd.h>
+
 using namespace aioutils;
 
-#define SQ_CQ_MIN_NUMBER 4096
+#define FIXED_FILES_NUMBER 16384
+#define READ_BUFFER_GROUP 0
+#define READ_BUFFERS_NUMBER 1024
+#define READ_BUFFER_SIZE 16384
+#define PIPE_POOL_SIZE 256
+#define FIXED_BUFFERS_NUMBER 16
+#define FIXED_BUFFER_SIZE 262144
+#define PIPE_SIZE 262144
+// offered messages the ring runs per loop iteration, the rest wait for it or for a thief
+#define OFFERED_BATCH 16
+#define WAKEUP_USER_DATA 1
+#define LINK_TIMEOUT_USER_DATA 2
+#define CANCEL_USER_DATA 3
+#define MESSAGE_CLOSE_USER_DATA 4
+// set in user_data of multishot ops, tasks are at least 8-byte aligned
+#define MULTISHOT_USER_DATA_TAG 1
+// message nodes: the CQE posted to the receiver and the CQE of IORING_OP_MSG_RING itself
+#define MESSAGE_USER_DATA_TAG 2
+#define MESSAGE_SENT_USER_DATA_TAG 4
 
 AIOUring::AIOUring(std::optional<int> iouringBackend, bool useSQPoll) :
-        iouringBackend{iouringBackend}, useSQPoll{useSQPoll} {
+        AIOUring{iouringBackend, AIOUringSetupOptions{.sqPoll = useSQPoll}} {
+
+}
+
+AIOUring::AIOUring(std::optional<int> iouringBackend, AIOUringSetupOptions setupOptions) :
+        iouringBackend{iouringBackend}, setupOptions{setupOptions}, pipePool{PIPE_POOL_SIZE, PIPE_SIZE} {
     instanceId = idGenerator.fetch_add(1);
 }
 
+AIOUring::~AIOUring() {
+    // connections offered for stealing which no ring has taken
+    for(auto &message : offered)
+    {
+        if(message.fd >= 0)
+        {
+            ::close(message.fd);
+        }
+    }
+
+    // jobs still queued or running in the blocking pool refer to the completion queue and the eventfd,
+    // a drained completion doesn't mean its job has stopped touching them
+    {
+        std::unique_lock<std::mutex> lock{longTaskJobsMutex};
+        longTaskJobsDone.wait(lock, [this]() { return longTaskJobs == 0; });
+    }
+
+    for(auto completion = longTaskCompletions.drain(); completion != nullptr; --longTaskStats.inFlight)
+    {
+        delete std::exchange(completion, completion->next);
+    }
+
+    dropUndeliveredMessages();
+
+    // registered buffers and files go before the ring they are registered with
+    bufferGroups.clear();
+    fixedBuffers.reset();
+
+    if(ringInitialized)
+    {
+        if(hasFileTable())
+        {
+            // drops the references of the table to the sockets still in it
+            io_uring_unregister_files(&ring);
+        }
+
+        io_uring_queue_exit(&ring);
+    }
+
+    if(wakeupfd >= 0)
+    {
+        ::close(wakeupfd);
+    }
+}
+
 void AIOUring::executeLongTask(AIOUringLongTask longTask) {
     if(longTask.task.has_value())
     {
-        executor.silent_async([=, this]() {
-            try {
-                (*longTask.task)(&executor);
-            } catch (std::exception &e) {
-                kklogging::ERROR(fmt::format("During long running task: {}", e.what()));
-            }
-            if(longTask.eventfd.has_value()) {
-                eventfd_write(*longTask.eventfd, 1L);
-            }
+        auto eventfd = longTask.eventfd;
+
+        getBlockingPool().submit(AIOUringBlockingJob {
+                .run = [task = std::move(*longTask.task), eventfd](tf::Executor *executor) {
+                    try {
+                        task(executor);
+                    } catch (std::exception &e) {
+                        kklogging::ERROR(fmt::format("During long running task: {}", e.what()));
+                    }
+                    if(eventfd.has_value()) {
+                        eventfd_write(*eventfd, 1L);
+                    }
+                },
+                .shed = []() {
+                    kklogging::WARN("Long running task has been shed by the blocking pool.");
+                },
+                .options = std::move(longTask.options)
         });
     }
 }
 
-std::tuple<bool, int> AIOUring::processCQE(io_uring_cqe *cqe) {
-    auto *task = static_cast<AIOUringTask *>(
-            reinterpret_cast<void *>(cqe->user_data));
+void AIOUring::setBlockingPool(AIOUringBlockingPool *pool) {
+    blockingPool = pool;
+}
 
-    try {
-        AIOUringTask::TaskFuture taskFuture = AIOUringTask::futureEmpty();
+AIOUringBlockingPool &AIOUring::getBlockingPool() {
+    if(blockingPool == nullptr)
+    {
+        blockingPool = &AIOUringBlockingPool::shared();
+    }
 
-        if(!task->isTaskFinal()) {
-            taskFuture = task->poll(cqe->res);
-        } else {
-            taskFuture = task->finally(cqe->res);
-        }
+    return *blockingPool;
+}
+
+void AIOUring::submitLongTask(AIOUringTask *task, const AIOUringJobOptions &options,
+                              std::function<int(tf::Executor *)> job) {
+    while(task->parentTask != nullptr)
+    {
+        task = task->parentTask;
+    }
 
-        std::optional<AIOUringOp> taskOp = std::get<0>(taskFuture);
+    auto completion = new AIOUringLongTaskCompletion{
+            .task = task,
+            .submittedAt = AIOUringLongTaskCompletion::Clock::now()
+    };
 
-        if(!taskOp.has_value())
-        {
-            try {
-                std::optional<std::any> &result = std::get<1>(taskFuture);
-                if(result.has_value()) {
-                    auto error = std::any_cast<std::runtime_error>(*result);
-                    kklogging::ERROR(fmt::format("{}: {}", task->getClassName(), error.what()));
+    task->longTaskRunning = true;
+    ++longTaskStats.submitted;
+
+    {
+        std::lock_guard<std::mutex> lock{longTaskJobsMutex};
+        ++longTaskJobs;
+    }
+
+    longTaskStats.inFlightHighWater = std::max(longTaskStats.inFlightHighWater, ++longTaskStats.inFlight);
+
+    getBlockingPool().submit(AIOUringBlockingJob {
+            .run = [this, completion, job = std::move(job)](tf::Executor *executor) mutable {
+                completion->startedAt = AIOUringLongTaskCompletion::Clock::now();
+
+                try {
+                    completion->result = job(executor);
+                } catch (std::exception &e) {
+                    kklogging::ERROR(fmt::format("During long running task: {}", e.what()));
+                    completion->result = -EIO;
                 }
-            } catch(...) {};
 
-            if(!task->isTaskFinal()) {
-                task->setTaskFinal();
-                auto op = AIOUringOp::Nop();
-                (*op.submit)(&this->ring, cqe->user_data);
-            } else {
-                freeTask(task);
-            }
-        }
-        else
-        {
-            auto op = *taskOp;
+                completion->finishedAt = AIOUringLongTaskCompletion::Clock::now();
+                pushLongTaskCompletion(completion);
+            },
+            .shed = [this, completion]() {
+                completion->startedAt = AIOUringLongTaskCompletion::Clock::now();
+                completion->finishedAt = completion->startedAt;
+                completion->result = -EBUSY;
+                pushLongTaskCompletion(completion);
+            },
+            .options = options
+    });
+}
 
-            if(op.shutdown)
-            {
-                return std::make_tuple(false, op.shutdownCode);
-            }
+void AIOUring::pushLongTaskCompletion(AIOUringLongTaskCompletion *completion) {
+    // the ring drains every completion queued so far, only the first one wakes it
+    if(longTaskCompletions.push(completion))
+    {
+        longTaskWakeups.fetch_add(1, std::memory_order_relaxed);
+        eventfd_write(wakeupfd, 1L);
+    }
 
-            if(op.submit.has_value())
-            {
-                (*op.submit)(&this->ring, cqe->user_data);
-            }
-            else
-            {
-                kklogging::ERROR("No submit function for operation.");
-            }
-        }
+    // the last access of the job to the ring, the destructor can't return before the lock is released
+    std::lock_guard<std::mutex> lock{longTaskJobsMutex};
+
+    if(--longTaskJobs == 0)
+    {
+        longTaskJobsDone.notify_all();
     }
-    catch(std::exception &e) {
-        kklogging::ERROR(fmt::format("Uncaught exception during poll/finally(), task {}: {}",
-                                     task->getClassName(), e.what()));
-        return std::make_tuple(false, 1);
+}
+
+void AIOUring::drainLongTasks() {
+    if(longTaskCompletions.empty())
+    {
+        return;
     }
 
-    return std::make_tuple(true, 0);
-}
+    auto now = AIOUringLongTaskCompletion::Clock::now();
+    size_t batch = 0;
 
-int AIOUring::run() {
-    kklogging::INFO("IO_URING has started.");
-    while(true)
+    for(auto completion = longTaskCompletions.drain(); completion != nullptr; ++batch)
     {
-        auto result = io_uring_submit_and_wait(&ring, 1);
-        struct io_uring_cqe *cqe;
-        unsigned head;
-        unsigned count = 0;
+        auto queueWait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                completion->startedAt - completion->submittedAt);
+        auto resumeLatency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - completion->finishedAt);
+        AIOUringTask *task = completion->task;
+        int result = completion->result;
 
-        if(result < 0)
+        longTaskQueueWaitSumNs += static_cast<uint64_t>(queueWait.count());
+        longTaskResumeLatencySumNs += static_cast<uint64_t>(resumeLatency.count());
+        longTaskStats.queueWaitMaxNs = std::max(longTaskStats.queueWaitMaxNs,
+                                                static_cast<uint64_t>(queueWait.count()));
+        longTaskStats.resumeLatencyMaxNs = std::max(longTaskStats.resumeLatencyMaxNs,
+                                                    static_cast<uint64_t>(resumeLatency.count()));
+        ++longTaskStats.completed;
+        --longTaskStats.inFlight;
+
+        delete std::exchange(completion, completion->next);
+
+        task->longTaskRunning = false;
+
+        if(task->cancelPending)
         {
-            kklogging::ERROR("io_uring_submit_and_wait failed: " + uexcept::errnoStr(-result));
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            continue;
+            task->cancelPending = false;
+            result = -ECANCELED;
         }
 
-        io_uring_for_each_cqe(&ring, head, cqe) {
-            ++count;
+        scheduleTask(task, result);
+    }
 
-            if(cqe->user_data == 0)
-            {
-                kklogging::ERROR("cqe->user_data == 0");
-                continue;
-            }
+    longTaskStats.completionBatchMax = std::max(longTaskStats.completionBatchMax, batch);
+}
 
-            auto res = processCQE(cqe);
+bool AIOUring::sendTo(AIOUring *target, AIOUringMessage message) {
+    message.from = instanceId;
 
-            if(!std::get<0>(res)) {
-                kklogging::WARN("IO_URING shutdown.");
-                return std::get<1>(res);
-            }
+    if(target->finished.load())
+    {
+        kklogging::WARN(fmt::format("Ring {}: ring {} has stopped, the message {} isn't sent.",
+                                    instanceId, target->getInstanceId(), message.type));
+        return false;
+    }
+
+    bool directFd = AIOUringOp::isDirectFd(message.fd);
+    bool useRing = target != this && isOpSupported(IORING_OP_MSG_RING) && target->acceptsMessageRing();
+
+    if(directFd && target != this && !(useRing && target->messageRingFd))
+    {
+        kklogging::ERROR(fmt::format("Ring {} can't pass a direct fd to ring {}.",
+                                     instanceId, target->getInstanceId()));
+        return false;
+    }
+
+    auto node = new AIOUringMessageNode{.target = target, .message = std::move(message)};
+    io_uring_sqe *sqe = useRing ? getSqe(directFd ? 2 : 1) : nullptr;
+
+    if(sqe == nullptr)
+    {
+        if(directFd && target != this)
+        {
+            kklogging::ERROR(fmt::format("Ring {}: no room in the SQ to pass a direct fd.", instanceId));
+            node->message.fd = -1;
+            delete node;
+            return false;
         }
 
-        io_uring_cq_advance(&ring, count);
+        ++messageStats.sentQueue;
+        target->pushMessage(node);
+        return true;
+    }
+
+    auto data = reinterpret_cast<__u64>(node) | MESSAGE_USER_DATA_TAG;
+
+    if(directFd)
+    {
+        unsigned index = AIOUringOp::directIndex(node->message.fd);
+
+        io_uring_prep_msg_ring_fd_alloc(sqe, target->getRingFd(), static_cast<int>(index), data, 0);
+        // the slot of the sender is closed once the receiver has its own
+        sqe->flags |= IOSQE_IO_LINK;
+        sqe->user_data = reinterpret_cast<__u64>(node) | MESSAGE_SENT_USER_DATA_TAG;
+
+        io_uring_sqe *closeSqe = io_uring_get_sqe(&ring);
+
+        io_uring_prep_close_direct(closeSqe, index);
+        closeSqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+        closeSqe->user_data = MESSAGE_CLOSE_USER_DATA;
+
+        ++messageStats.sentFds;
+    }
+    else
+    {
+        io_uring_prep_msg_ring(sqe, target->getRingFd(), 0, data, 0);
+        sqe->user_data = reinterpret_cast<__u64>(node) | MESSAGE_SENT_USER_DATA_TAG;
+    }
+
+    ++messageStats.sentRing;
+
+    return true;
+}
+
+void AIOUring::setMessageHandler(uint32_t type, AIOUringMessageHandler handler) {
+    messageHandlers[type] = std::move(handler);
+}
+
+bool AIOUring::acceptsMessageRing() const {
+    return messageRing;
+}
+
+AIOUringMessageStats AIOUring::getMessageStats() const {
+    return messageStats;
+}
+
+void AIOUring::pushMessage(AIOUringMessageNode *node) {
+    if(messages.push(node))
+    {
+        eventfd_write(wakeupfd, 1L);
     }
 }
 
-void AIOUring::setup() {
-    if(useSQPoll)
+void AIOUring::drainMessages() {
+    if(messages.empty())
     {
-        useSQPoll = ulinux::linuxKernelNotLessThan(5, 11);
+        return;
     }
 
-    if(useSQPoll)
+    for(auto node = messages.drain(); node != nullptr;)
     {
-        params.flags |= IORING_SETUP_SQPOLL;
-        params.sq_thread_idle = 2000;
+        ++messageStats.receivedQueue;
+
+        dispatchMessage(std::move(node->message));
+
+        delete std::exchange(node, node->next);
     }
+}
 
-    if(!useSQPoll)
+void AIOUring::dropUndeliveredMessages() {
+    auto dropFd = [this](int fd) {
+        // direct fds go with the file table of the ring
+        if(fd >= 0 && !AIOUringOp::isDirectFd(fd))
+        {
+            ::close(fd);
+        }
+
+        ++messageStats.dropped;
+    };
+
+    for(auto node = messages.drain(); node != nullptr;)
     {
-        kklogging::INFO("SqlPoll is disabled");
+        dropFd(node->message.fd);
+        delete std::exchange(node, node->next);
     }
 
-    if(iouringBackend.has_value())
+    if(!ringInitialized)
     {
-        params.flags |= IORING_SETUP_ATTACH_WQ;
-        params.wq_fd = *iouringBackend;
+        return;
     }
 
-    if (io_uring_queue_init_params(SQ_CQ_MIN_NUMBER, &ring, &params) < 0) {
-        if(errno == EPERM)
+    struct io_uring_cqe *cqe;
+    unsigned head;
+    unsigned count = 0;
+
+    // IORING_OP_MSG_RING posts and failed sends of this ring, other completions have no owner anymore
+    io_uring_for_each_cqe(&ring, head, cqe) {
+        ++count;
+
+        if(cqe->user_data <= MESSAGE_CLOSE_USER_DATA || cqe->user_data == LIBURING_UDATA_TIMEOUT ||
+           !(cqe->user_data & (MESSAGE_USER_DATA_TAG | MESSAGE_SENT_USER_DATA_TAG)))
         {
-            throw AIOUringException("Operation not permitted. TRY ROOT or disable SQPOLL by setting "
-                                    "RTSP_PROXY_IOURING_USE_SQPOLL=false. If it is run from docker try --privileged.");
+            continue;
         }
-        else
+
+        auto node = reinterpret_cast<AIOUringMessageNode *>(
+                cqe->user_data & ~__u64{MESSAGE_USER_DATA_TAG | MESSAGE_SENT_USER_DATA_TAG});
+
+        // on success a sent node belongs to the receiver
+        if((cqe->user_data & MESSAGE_USER_DATA_TAG) || cqe->res < 0)
         {
-            THROW_ERRNO(AIOUringException, "During io_uring_queue_init_params");
+            dropFd(node->message.fd);
+            delete node;
         }
     }
 
-    if (!(params.features & IORING_FEAT_FAST_POLL)) {
-        throw AIOUringException("IORING_FEAT_FAST_POLL not available in the kernel. "
-                                "It is available starting from 5.7 kernel version.");
+    io_uring_cq_advance(&ring, count);
+}
+
+void AIOUring::completeMessageSend(AIOUringMessageNode *node, int result) {
+    // on success the receiver owns the node and may have freed it already
+    if(result >= 0)
+    {
+        return;
     }
 
-    if(useSQPoll)
+    ++messageStats.ringFailures;
+
+    if(AIOUringOp::isDirectFd(node->message.fd))
     {
-        if (!(params.features & IORING_FEAT_SQPOLL_NONFIXED)) {
-            throw AIOUringException("IORING_FEAT_SQPOLL_NONFIXED not available in the kernel. "
-                                    "It is available starting from 5.11 kernel version.");
-        }
+        // the linked close has been canceled, the fd is still in the table of this ring
+        kklogging::ERROR(fmt::format("Ring {}: passing a direct fd to ring {} failed: {}", instanceId,
+                                     node->target->getInstanceId(), uexcept::errnoStr(-result)));
+        ++messageStats.dropped;
+        closeFd(node->message.fd);
+        delete node;
+        return;
     }
 
-    setupPassed = true;
+    // e.g. the CQ of the receiver is full
+    --messageStats.sentRing;
+    ++messageStats.sentQueue;
+    node->target->pushMessage(node);
 }
 
-int AIOUring::getInstanceId() const {
-    return instanceId;
+void AIOUring::receiveMessage(AIOUringMessageNode *node, int result) {
+    ++messageStats.receivedRing;
+
+    if(AIOUringOp::isDirectFd(node->message.fd))
+    {
+        // the slot allocated in the file table of this ring
+        node->message.fd = AIOUringOp::directFd(static_cast<unsigned>(result));
+    }
+
+    dispatchMessage(std::move(node->message));
+
+    delete node;
+}
+
+void AIOUring::dispatchMessage(AIOUringMessage message) {
+    auto handler = messageHandlers.find(message.type);
+
+    if(handler == messageHandlers.end())
+    {
+        kklogging::WARN(fmt::format("Ring {}: no handler for message {} from ring {}.",
+                                    instanceId, message.type, message.from));
+        ++messageStats.dropped;
+        closeFd(message.fd);
+        return;
+    }
+
+    uint32_t type = message.type;
+
+    try {
+        handler->second(this, std::move(message));
+    } catch (std::exception &e) {
+        kklogging::ERROR(fmt::format("Ring {}: message handler {}: {}", instanceId, type, e.what()));
+    }
+}
+
+void AIOUring::closeFd(int fd) {
+    if(fd < 0)
+    {
+        return;
+    }
+
+    if(!AIOUringOp::isDirectFd(fd))
+    {
+        ::close(fd);
+        return;
+    }
+
+    io_uring_sqe *sqe = getSqe();
+
+    if(sqe == nullptr)
+    {
+        kklogging::ERROR(fmt::format("Ring {}: no room in the SQ to close direct fd {}.",
+                                     instanceId, AIOUringOp::directIndex(fd)));
+        return;
+    }
+
+    io_uring_prep_close_direct(sqe, AIOUringOp::directIndex(fd));
+    sqe->user_data = MESSAGE_CLOSE_USER_DATA;
+}
+
+AIOUringLoad AIOUring::getLoad() const {
+    return loadMeter.load();
+}
+
+void AIOUring::distribute(AIOUringMessage message) {
+    message.from = instanceId;
+
+    if(balancer == nullptr)
+    {
+        dispatchMessage(std::move(message));
+        return;
+    }
+
+    AIOUring *target = balancer->steerTarget(this);
+
+    // sendTo() leaves a direct fd it can't pass with this ring
+    if(target != nullptr && sendTo(target, message))
+    {
+        ++balanceStats.steered;
+        return;
+    }
+
+    // a direct fd is valid only in the file table of this ring, it can't be stolen
+    if(AIOUringOp::isDirectFd(message.fd) || !balancer->getOptions().stealWork)
+    {
+        dispatchMessage(std::move(message));
+        return;
+    }
+
+    size_t number{0};
+
+    {
+        std::lock_guard<std::mutex> lock{offeredMutex};
+        offered.push_back(std::move(message));
+        number = offered.size();
+        loadMeter.setOffered(number);
+    }
+
+    ++balanceStats.offered;
+
+    if(number % std::max<size_t>(1, balancer->getOptions().stealThreshold) == 0)
+    {
+        balancer->wakeThief(this);
+    }
+}
+
+void AIOUring::nudge() {
+    if(!nudged.exchange(true))
+    {
+        eventfd_write(wakeupfd, 1L);
+    }
+}
+
+AIOUringBalanceStats AIOUring::getBalanceStats() const {
+    AIOUringBalanceStats stats = balanceStats;
+
+    stats.stolenFrom = stolenFrom.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void AIOUring::balanceLoad() {
+    auto interval = balancer != nullptr ? balancer->getOptions().sampleInterval
+                                        : AIOUringBalanceOptions{}.sampleInterval;
+    bool sampled = loadMeter.sample(AIOUringLoadMeter::Clock::now(), interval);
+
+    if(balancer == nullptr)
+    {
+        return;
+    }
+
+    runOffered();
+
+    bool nudgedNow = nudged.load(std::memory_order_relaxed) && nudged.exchange(false);
+
+    // a ring with work of its own doesn't steal
+    if((nudgedNow || sampled) && readyCount == 0 && loadMeter.load().offered == 0)
+    {
+        stealOffered();
+    }
+}
+
+void AIOUring::runOffered() {
+    for(auto &message : takeOffered(OFFERED_BATCH))
+    {
+        dispatchMessage(std::move(message));
+    }
+}
+
+void AIOUring::stealOffered() {
+    AIOUring *victim = balancer->stealVictim(this);
+
+    if(victim == nullptr)
+    {
+        return;
+    }
+
+    auto stolen = victim->takeOffered((victim->getLoad().offered + 1) / 2);
+
+    victim->stolenFrom.fetch_add(stolen.size(), std::memory_order_relaxed);
+    balanceStats.stolen += stolen.size();
+
+    for(auto &message : stolen)
+    {
+        dispatchMessage(std::move(message));
+    }
+}
+
+std::deque<AIOUringMessage> AIOUring::takeOffered(size_t number) {
+    std::deque<AIOUringMessage> taken{};
+    std::lock_guard<std::mutex> lock{offeredMutex};
+
+    if(offered.empty())
+    {
+        return taken;
+    }
+
+    if(number >= offered.size())
+    {
+        taken.swap(offered);
+    }
+    else
+    {
+        auto last = offered.begin() + static_cast<std::ptrdiff_t>(number);
+
+        std::move(offered.begin(), last, std::back_inserter(taken));
+        offered.erase(offered.begin(), last);
+    }
+
+    loadMeter.setOffered(offered.size());
+
+    return taken;
+}
+
+void AIOUring::scheduleTask(AIOUringTask *task, int ioResult, unsigned cqeFlags) {
+    task->readyResult = ioResult;
+    task->readyFlags = cqeFlags;
+    task->readyNext = nullptr;
+
+    if(readyTail == nullptr)
+    {
+        readyHead = task;
+    }
+    else
+    {
+        readyTail->readyNext = task;
+    }
+
+    readyTail = task;
+    ++readyCount;
+}
+
+std::tuple<bool, int> AIOUring::runReadyTasks() {
+    // only tasks queued before this pass are polled, so yielding tasks can't starve io
+    for(auto pending = readyCount; pending > 0; --pending)
+    {
+        AIOUringTask *task = readyHead;
+
+        readyHead = task->readyNext;
+
+        if(readyHead == nullptr)
+        {
+            readyTail = nullptr;
+        }
+
+        task->readyNext = nullptr;
+        --readyCount;
+
+        // a multishot completion kept while the task was busy
+        selectCqeBuffer(task->multishotOp.bufferGroup, task->readyFlags);
+
+        auto res = processTask(task, task->readyResult);
+
+        releaseCqeBuffer();
+
+        if(!std::get<0>(res)) {
+            return res;
+        }
+    }
+
+    return std::make_tuple(true, 0);
+}
+
+std::tuple<bool, int> AIOUring::processTask(AIOUringTask *task, int ioResult) {
+    try {
+        AIOUringTask::TaskFuture taskFuture = AIOUringTask::futureEmpty();
+
+        if(!task->isTaskFinal()) {
+            taskFuture = task->poll(ioResult);
+        } else {
+            taskFuture = task->finally(ioResult);
+        }
+
+        std::optional<AIOUringOp> &taskOp = std::get<0>(taskFuture);
+
+        if(!taskOp.has_value())
+        {
+            std::optional<AIOUringTaskError> &error = std::get<1>(taskFuture);
+
+            if(error.has_value()) {
+                kklogging::ERROR(fmt::format("{}: {}", task->getClassName(), error->what()));
+            }
+
+            if(!task->isTaskFinal()) {
+                task->setTaskFinal();
+                scheduleTask(task);
+            } else if(task->multishotArmed || task->zeroCopyPending() > 0) {
+                // the kernel still refers to the task, it is freed on the last CQE
+                task->freePending = true;
+
+                if(task->multishotArmed) {
+                    submitCancel(reinterpret_cast<__u64>(task) | MULTISHOT_USER_DATA_TAG);
+                }
+            } else {
+                freeTask(task);
+            }
+        }
+        else
+        {
+            const AIOUringOp &op = *taskOp;
+
+            if(op.isShutdownUring())
+            {
+                return std::make_tuple(false, op.shutdownCode());
+            }
+
+            if(op.isYield())
+            {
+                scheduleTask(task);
+            }
+            else if(op.kind == AIOUringOp::Kind::Empty)
+            {
+                kklogging::ERROR("Empty operation has been returned.");
+            }
+            else if(op.isLongTask())
+            {
+                // resumed by drainLongTasks(), a cancellation waits for the job as well:
+                // the job may still write into the task
+            }
+            else if(task->cancelPending && !task->isTaskFinal())
+            {
+                // cancellation requested while the task wasn't waiting, deliver it instead of the wait
+                task->cancelPending = false;
+                scheduleTask(task, -ECANCELED);
+            }
+            else if(op.isPark())
+            {
+                parkTask(static_cast<AIOUringTask *>(op.addr), task);
+            }
+            else if(op.isDeadline())
+            {
+                sleepTask(task, op.deadline());
+            }
+            else if(op.isMultishot())
+            {
+                awaitMultishot(op, task);
+            }
+            else if(op.isZeroCopyFlush())
+            {
+                if(task->zeroCopyPending() <= op.len) {
+                    scheduleTask(task);
+                } else {
+                    task->zeroCopyWaiting = true;
+                    task->zeroCopyKeep = op.len;
+                }
+            }
+            else
+            {
+                submitOp(op, task);
+            }
+        }
+    }
+    catch(std::exception &e) {
+        kklogging::ERROR(fmt::format("Uncaught exception during poll/finally(), task {}: {}",
+                                     task->getClassName(), e.what()));
+        return std::make_tuple(false, 1);
+    }
+
+    return std::make_tuple(true, 0);
+}
+
+int AIOUring::run() {
+    int code = runLoop();
+
+    finished.store(true);
+    // senders which checked finished before it was set
+    dropUndeliveredMessages();
+
+    return code;
+}
+
+int AIOUring::runLoop() {
+    kklogging::INFO("IO_URING has started.");
+    AIOUringFrameAllocator::setCurrent(&frameAllocator);
+    while(true)
+    {
+        if(stopRequested.load())
+        {
+            kklogging::WARN("IO_URING stop requested.");
+            return stopCode.load();
+        }
+
+        expireTimers();
+        drainLongTasks();
+        drainMessages();
+        balanceLoad();
+
+        auto readyRes = runReadyTasks();
+
+        if(!std::get<0>(readyRes)) {
+            kklogging::WARN("IO_URING shutdown.");
+            return std::get<1>(readyRes);
+        }
+
+        resumeBufferWaiters();
+        flushDeferredSqes();
+
+        auto waitStart = AIOUringLoadMeter::Clock::now();
+        auto result = submitAndWait();
+
+        loadMeter.addIdle(AIOUringLoadMeter::Clock::now() - waitStart);
+
+        struct io_uring_cqe *cqe;
+        unsigned head;
+        unsigned count = 0;
+
+        if(result < 0)
+        {
+            kklogging::ERROR("io_uring_submit_and_wait failed: " + uexcept::errnoStr(-result));
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            ++count;
+
+            if(cqe->user_data == 0)
+            {
+                kklogging::ERROR("cqe->user_data == 0");
+                continue;
+            }
+
+            if(cqe->user_data == LINK_TIMEOUT_USER_DATA || cqe->user_data == CANCEL_USER_DATA ||
+               cqe->user_data == MESSAGE_CLOSE_USER_DATA || cqe->user_data == LIBURING_UDATA_TIMEOUT)
+            {
+                // the linked op itself completes with -ECANCELED on expiry
+                continue;
+            }
+
+            if(cqe->user_data == WAKEUP_USER_DATA)
+            {
+                if(stopRequested.load())
+                {
+                    kklogging::WARN("IO_URING stop requested.");
+                    return stopCode.load();
+                }
+                armWakeup();
+                continue;
+            }
+
+            if(cqe->user_data & (MESSAGE_USER_DATA_TAG | MESSAGE_SENT_USER_DATA_TAG))
+            {
+                auto node = reinterpret_cast<AIOUringMessageNode *>(
+                        cqe->user_data & ~__u64{MESSAGE_USER_DATA_TAG | MESSAGE_SENT_USER_DATA_TAG});
+
+                if(cqe->user_data & MESSAGE_USER_DATA_TAG) {
+                    receiveMessage(node, cqe->res);
+                } else {
+                    completeMessageSend(node, cqe->res);
+                }
+                continue;
+            }
+
+            if(cqe->user_data & MULTISHOT_USER_DATA_TAG)
+            {
+                auto task = reinterpret_cast<AIOUringTask *>(cqe->user_data & ~__u64{MULTISHOT_USER_DATA_TAG});
+
+                if(cqe->res > 0 && task->multishotOp.kind == AIOUringOp::Kind::RecvMultishot)
+                {
+                    loadMeter.addBytes(static_cast<uint64_t>(cqe->res));
+                }
+
+                auto res = completeMultishot(task, cqe->res, cqe->flags);
+
+                if(!std::get<0>(res)) {
+                    kklogging::WARN("IO_URING shutdown.");
+                    return std::get<1>(res);
+                }
+                continue;
+            }
+
+            auto task = static_cast<AIOUringTask *>(reinterpret_cast<void *>(cqe->user_data));
+
+            if(cqe->flags & IORING_CQE_F_NOTIF)
+            {
+                completeZeroCopy(task);
+                continue;
+            }
+
+            if(cqe->flags & IORING_CQE_F_MORE)
+            {
+                // SendZC, its notification follows once the kernel is done with the buffer
+                ++task->zeroCopySent;
+            }
+
+            task->inFlight = false;
+
+            int ioResult = cqe->res;
+
+            if(ioResult > 0 && AIOUringOp::movesData(task->inFlightKind))
+            {
+                loadMeter.addBytes(static_cast<uint64_t>(ioResult));
+            }
+
+            if(task->bufferSelectOp.isBufferSelect())
+            {
+                auto bufferRing = bufferGroups.find(static_cast<uint16_t>(task->bufferSelectOp.bufferGroup));
+
+                if(ioResult == -ENOBUFS && bufferRing != bufferGroups.end())
+                {
+                    bufferRing->second->noteExhausted();
+
+                    if(!task->cancelPending)
+                    {
+                        // the op waits for a buffer to be recycled instead of failing
+                        task->bufferWaiting = true;
+                        bufferWaiters.push_back(task);
+                        continue;
+                    }
+
+                    ioResult = -ECANCELED;
+                }
+
+                holdCqeBuffer(task->bufferSelectOp.bufferGroup, cqe->flags);
+                selectCqeBuffer(task->bufferSelectOp.bufferGroup, cqe->flags);
+                task->bufferSelectOp = AIOUringOp{};
+            }
+
+            if(ioResult == -ECANCELED)
+            {
+                task->cancelPending = false;
+            }
+
+            auto res = processTask(task, ioResult);
+
+            releaseCqeBuffer();
+
+            if(!std::get<0>(res)) {
+                kklogging::WARN("IO_URING shutdown.");
+                return std::get<1>(res);
+            }
+        }
+
+        io_uring_cq_advance(&ring, count);
+        loadMeter.addCqes(count);
+        checkCqOverflow();
+    }
+}
+
+void AIOUring::setup() {
+    if(setupOptions.sqPoll)
+    {
+        setupOptions.sqPoll = ulinux::linuxKernelNotLessThan(5, 11);
+    }
+
+    if(setupOptions.sqPoll)
+    {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = static_cast<__u32>(setupOptions.sqThreadIdle.count());
+
+        if(setupOptions.sqThreadCpu.has_value())
+        {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = *setupOptions.sqThreadCpu;
+        }
+    }
+
+    if(!setupOptions.sqPoll)
+    {
+        kklogging::INFO("SqlPoll is disabled");
+    }
+
+    if(iouringBackend.has_value())
+    {
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd = *iouringBackend;
+    }
+
+    if(setupOptions.cqEntries > 0)
+    {
+        // sizes above the kernel limits are clamped instead of failing the setup
+        params.flags |= IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+        params.cq_entries = setupOptions.cqEntries;
+    }
+
+    initRing();
+
+    if (!(params.features & IORING_FEAT_FAST_POLL)) {
+        throw AIOUringException("IORING_FEAT_FAST_POLL not available in the kernel. "
+                                "It is available starting from 5.7 kernel version.");
+    }
+
+    if(setupOptions.sqPoll)
+    {
+        if (!(params.features & IORING_FEAT_SQPOLL_NONFIXED)) {
+            throw AIOUringException("IORING_FEAT_SQPOLL_NONFIXED not available in the kernel. "
+                                    "It is available starting from 5.11 kernel version.");
+        }
+    }
+
+    setupFileTable();
+    setupReadBufferGroup();
+
+    probeOps();
+
+    multishotAccept = ulinux::linuxKernelNotLessThan(5, 19);
+    multishotRecv = ulinux::linuxKernelNotLessThan(6, 0);
+
+    // before 6.3 a CQE posted by another ring doesn't wake a DEFER_TASKRUN ring reliably
+    messageRing = isOpSupported(IORING_OP_MSG_RING) &&
+                  (!setupOptions.deferTaskrun || ulinux::linuxKernelNotLessThan(6, 3));
+    // IORING_MSG_SEND_FD installs into a slot allocated in the file table of the receiver
+    messageRingFd = messageRing && hasFileTable() && ulinux::linuxKernelNotLessThan(6, 0);
+
+    wakeupfd = eventfd(0, EFD_CLOEXEC);
+
+    if(wakeupfd < 0)
+    {
+        THROW_ERRNO(AIOUringException, "During eventfd for wakeup");
+    }
+
+    armWakeup();
+
+    // coroutines are usually created right after setup, on the thread of the ring
+    AIOUringFrameAllocator::setCurrent(&frameAllocator);
+
+    setupPassed = true;
+}
+
+unsigned AIOUring::optionalSetupFlags() {
+    unsigned flags = 0;
+
+    // task work flags only make sense for a ring which reaps its own completions
+    if(setupOptions.sqPoll)
+    {
+        setupOptions.deferTaskrun = false;
+        setupOptions.coopTaskrun = false;
+    }
+
+    if(setupOptions.deferTaskrun && ulinux::linuxKernelNotLessThan(6, 1))
+    {
+        flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    }
+    else
+    {
+        setupOptions.deferTaskrun = false;
+    }
+
+    if(setupOptions.coopTaskrun && ulinux::linuxKernelNotLessThan(5, 19))
+    {
+        flags |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+    }
+    else
+    {
+        setupOptions.coopTaskrun = false;
+    }
+
+    return flags;
+}
+
+void AIOUring::initRing() {
+    unsigned optionalFlags = optionalSetupFlags();
+    io_uring_params initParams = params;
+
+    initParams.flags |= optionalFlags;
+
+    auto result = io_uring_queue_init_params(setupOptions.sqEntries, &ring, &initParams);
+
+    if(result == -EINVAL && optionalFlags != 0)
+    {
+        // a backported or restricted kernel may reject the flags despite its version
+        kklogging::WARN("io_uring_queue_init_params rejected SINGLE_ISSUER/DEFER_TASKRUN/COOP_TASKRUN, "
+                        "setting up the ring without them.");
+        setupOptions.deferTaskrun = false;
+        setupOptions.coopTaskrun = false;
+        initParams = params;
+        result = io_uring_queue_init_params(setupOptions.sqEntries, &ring, &initParams);
+    }
+
+    if(result < 0)
+    {
+        if(result == -EPERM)
+        {
+            throw AIOUringException("Operation not permitted. TRY ROOT or disable SQPOLL by setting "
+                                    "RTSP_PROXY_IOURING_USE_SQPOLL=false. If it is run from docker try --privileged.");
+        }
+        else
+        {
+            throw AIOUringException("During io_uring_queue_init_params: " + uexcept::errnoStr(-result));
+        }
+    }
+
+    params = initParams;
+    ringInitialized = true;
+    ringStats.sqEntries = params.sq_entries;
+    ringStats.cqEntries = params.cq_entries;
+
+    if(setupOptions.registerRingFd && ulinux::linuxKernelNotLessThan(5, 18))
+    {
+        result = io_uring_register_ring_fd(&ring);
+
+        if(result < 0)
+        {
+            kklogging::WARN("io_uring_register_ring_fd failed: " + uexcept::errnoStr(-result));
+            setupOptions.registerRingFd = false;
+        }
+    }
+    else
+    {
+        setupOptions.registerRingFd = false;
+    }
+
+    kklogging::INFO(fmt::format("Ring setup: SQ={}, CQ={}, DEFER_TASKRUN={}, COOP_TASKRUN={}, registered ring fd={}.",
+                                params.sq_entries, params.cq_entries, setupOptions.deferTaskrun,
+                                setupOptions.coopTaskrun, setupOptions.registerRingFd));
+}
+
+void AIOUring::setupFileTable() {
+    // slots are allocated by the kernel (IORING_FILE_INDEX_ALLOC), which needs 5.19
+    if(!ulinux::linuxKernelNotLessThan(5, 19))
+    {
+        kklogging::INFO("Registered file table is disabled, it needs 5.19 kernel version.");
+        return;
+    }
+
+    rlimit filesLimit{};
+    unsigned tableSize = FIXED_FILES_NUMBER;
+
+    // the kernel refuses a table larger than RLIMIT_NOFILE
+    if(getrlimit(RLIMIT_NOFILE, &filesLimit) == 0 && filesLimit.rlim_cur < tableSize)
+    {
+        tableSize = static_cast<unsigned>(filesLimit.rlim_cur);
+    }
+
+    auto result = io_uring_register_files_sparse(&ring, tableSize);
+
+    if(result < 0)
+    {
+        kklogging::WARN("Registered file table is disabled, io_uring_register_files_sparse failed: " +
+                        uexcept::errnoStr(-result));
+        return;
+    }
+
+    fileTableSize = tableSize;
+}
+
+bool AIOUring::hasFileTable() const {
+    return fileTableSize > 0;
+}
+
+void AIOUring::setupFixedBuffers() {
+    rlimit lockLimit{};
+    unsigned buffers = FIXED_BUFFERS_NUMBER;
+
+    // registered pages are accounted to RLIMIT_MEMLOCK, leave half of it to the rest,
+    // the other half is split between the rings of the process
+    if(getrlimit(RLIMIT_MEMLOCK, &lockLimit) == 0 && lockLimit.rlim_cur != RLIM_INFINITY)
+    {
+        auto shares = std::max(1u, setupOptions.lockedMemoryShares);
+
+        buffers = std::min(buffers, static_cast<unsigned>(lockLimit.rlim_cur / 2 / shares / FIXED_BUFFER_SIZE));
+    }
+
+    if(buffers == 0)
+    {
+        kklogging::INFO("Registered buffers are disabled, RLIMIT_MEMLOCK is too low.");
+        return;
+    }
+
+    try {
+        fixedBuffers = std::make_unique<AIOUringFixedBuffers>(&ring, buffers, FIXED_BUFFER_SIZE);
+    } catch (AIOUringException &e) {
+        kklogging::WARN(fmt::format("Registered buffers are disabled: {}", e.what()));
+    }
+}
+
+bool AIOUring::hasFixedBuffers() const {
+    return fixedBuffers != nullptr;
+}
+
+AIOUringFixedBuffer AIOUring::leaseFixedBuffer() {
+    // rings whose tasks never lease keep their memory unpinned
+    if(!fixedBuffersTried)
+    {
+        fixedBuffersTried = true;
+        setupFixedBuffers();
+    }
+
+    return fixedBuffers != nullptr ? fixedBuffers->lease() : AIOUringFixedBuffer{};
+}
+
+std::optional<AIOUringFixedBufferStats> AIOUring::getFixedBufferStats() const {
+    if(fixedBuffers == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    return fixedBuffers->getStats();
+}
+
+void AIOUring::probeOps() {
+    io_uring_probe *probe = io_uring_get_probe_ring(&ring);
+
+    if(probe == nullptr)
+    {
+        kklogging::WARN("IORING_REGISTER_PROBE failed, optional opcodes are disabled.");
+        return;
+    }
+
+    for(int opcode = 0; opcode < static_cast<int>(supportedOps.size()); ++opcode)
+    {
+        supportedOps[opcode] = io_uring_opcode_supported(probe, opcode) != 0;
+    }
+
+    io_uring_free_probe(probe);
+}
+
+bool AIOUring::isOpSupported(int opcode) const {
+    return opcode >= 0 && opcode < static_cast<int>(supportedOps.size()) && supportedOps[opcode];
+}
+
+void AIOUring::setZeroCopyThreshold(size_t threshold) {
+    zeroCopyThreshold = isOpSupported(IORING_OP_SEND_ZC) ? threshold : 0;
+}
+
+size_t AIOUring::getZeroCopyThreshold() const {
+    return zeroCopyThreshold;
+}
+
+std::optional<AIOUringPipe> AIOUring::acquirePipe() {
+    return pipePool.acquire();
+}
+
+void AIOUring::releasePipe(AIOUringPipe pipe, bool drained) {
+    pipePool.release(pipe, drained);
+}
+
+AIOUringPipePoolStats AIOUring::getPipePoolStats() const {
+    return pipePool.getStats();
+}
+
+bool AIOUring::supportsMultishotAccept() const {
+    return multishotAccept;
+}
+
+bool AIOUring::supportsMultishotRecv() const {
+    return multishotRecv;
+}
+
+void AIOUring::setupReadBufferGroup() {
+    // IORING_REGISTER_PBUF_RING is available starting from 5.19
+    if(!ulinux::linuxKernelNotLessThan(5, 19))
+    {
+        kklogging::INFO("Provided buffer rings are disabled, they need 5.19 kernel version.");
+        return;
+    }
+
+    try {
+        registerBufferGroup(READ_BUFFER_GROUP, READ_BUFFERS_NUMBER, READ_BUFFER_SIZE);
+        readBufferGroup = READ_BUFFER_GROUP;
+    } catch (AIOUringException &e) {
+        kklogging::WARN(fmt::format("Provided buffer rings are disabled: {}", e.what()));
+    }
+}
+
+AIOUringBufferRing &AIOUring::registerBufferGroup(uint16_t groupId, unsigned buffers, size_t bufferSize) {
+    if(bufferGroups.contains(groupId))
+    {
+        throw AIOUringException(fmt::format("Buffer group {} is already registered.", groupId));
+    }
+
+    auto bufferRing = std::make_unique<AIOUringBufferRing>(&ring, groupId, buffers, bufferSize);
+    auto &result = *bufferRing;
+
+    bufferGroups.emplace(groupId, std::move(bufferRing));
+
+    return result;
+}
+
+bool AIOUring::hasBufferGroup(int groupId) const {
+    return groupId >= 0 && groupId <= UINT16_MAX && bufferGroups.contains(static_cast<uint16_t>(groupId));
+}
+
+int AIOUring::getReadBufferGroup() const {
+    return readBufferGroup;
+}
+
+AIOUringBuffer AIOUring::takeBuffer(int ioResult) {
+    if(cqeBufferRing == nullptr)
+    {
+        return AIOUringBuffer{};
+    }
+
+    return std::exchange(cqeBufferRing, nullptr)->take(cqeBufferId, static_cast<size_t>(std::max(ioResult, 0)));
+}
+
+void AIOUring::selectCqeBuffer(int bufferGroup, unsigned cqeFlags) {
+    if(!(cqeFlags & IORING_CQE_F_BUFFER) || !hasBufferGroup(bufferGroup))
+    {
+        return;
+    }
+
+    cqeBufferRing = bufferGroups.at(static_cast<uint16_t>(bufferGroup)).get();
+    cqeBufferId = static_cast<uint16_t>(cqeFlags >> IORING_CQE_BUFFER_SHIFT);
+}
+
+void AIOUring::holdCqeBuffer(int bufferGroup, unsigned cqeFlags) {
+    if((cqeFlags & IORING_CQE_F_BUFFER) && hasBufferGroup(bufferGroup))
+    {
+        bufferGroups.at(static_cast<uint16_t>(bufferGroup))->hold(
+                static_cast<uint16_t>(cqeFlags >> IORING_CQE_BUFFER_SHIFT));
+    }
+}
+
+void AIOUring::recycleCqeBuffer(int bufferGroup, unsigned cqeFlags) {
+    if((cqeFlags & IORING_CQE_F_BUFFER) && hasBufferGroup(bufferGroup))
+    {
+        bufferGroups.at(static_cast<uint16_t>(bufferGroup))->recycle(
+                static_cast<uint16_t>(cqeFlags >> IORING_CQE_BUFFER_SHIFT));
+    }
+}
+
+void AIOUring::releaseCqeBuffer() {
+    if(cqeBufferRing != nullptr)
+    {
+        // the task didn't take the buffer, e.g. it was canceled meanwhile
+        std::exchange(cqeBufferRing, nullptr)->recycle(cqeBufferId);
+    }
+}
+
+void AIOUring::resumeBufferWaiters() {
+    for(size_t pending = bufferWaiters.size(); pending > 0; --pending)
+    {
+        AIOUringTask *task = bufferWaiters.front();
+        // a task waits for one op at a time, either a multishot or a single one
+        const bool multishot = task->multishotWaiting;
+        const AIOUringOp &op = multishot ? task->multishotOp : task->bufferSelectOp;
+        auto &bufferRing = bufferGroups.at(static_cast<uint16_t>(op.bufferGroup));
+
+        bufferWaiters.pop_front();
+
+        if(bufferRing->available() == 0)
+        {
+            bufferWaiters.push_back(task);
+            continue;
+        }
+
+        task->bufferWaiting = false;
+
+        if(multishot)
+        {
+            task->multishotWaiting = false;
+            awaitMultishot(task->multishotOp, task);
+        }
+        else
+        {
+            submitOp(task->bufferSelectOp, task);
+        }
+    }
+}
+
+std::vector<AIOUringBufferGroupStats> AIOUring::getBufferGroupStats() const {
+    std::vector<AIOUringBufferGroupStats> stats{};
+
+    for(auto &[groupId, bufferRing] : bufferGroups)
+    {
+        stats.push_back(bufferRing->getStats());
+    }
+
+    return stats;
+}
+
+void AIOUring::stop(int code) {
+    stopCode.store(code);
+    stopRequested.store(true);
+
+    if(wakeupfd >= 0)
+    {
+        eventfd_write(wakeupfd, 1L);
+    }
+}
+
+void AIOUring::submitOp(const AIOUringOp &op, AIOUringTask *task) {
+    struct io_uring_sqe *sqe = getSqe(op.hasLinkedTimeout() ? 2 : 1);
+
+    if(sqe == nullptr)
+    {
+        // in flight for cancelTask(), -ECANCELED is delivered instead of the submission
+        deferredSqes.push_back(DeferredSqe{.op = op, .task = task});
+        ++ringStats.sqDeferred;
+        task->inFlight = true;
+        task->inFlightKind = op.kind;
+        return;
+    }
+
+    if(op.timeoutNs > 0)
+    {
+        // a top level task has one op in flight, so its timespec can't be overwritten
+        task->opTimeout.tv_sec = static_cast<long long>(op.timeoutNs / 1000000000);
+        task->opTimeout.tv_nsec = static_cast<long long>(op.timeoutNs % 1000000000);
+    }
+
+    if(op.kind == AIOUringOp::Kind::Timeout)
+    {
+        AIOUringOp timeoutOp = op;
+        timeoutOp.addr = &task->opTimeout;
+        timeoutOp.prepareSqe(sqe);
+    }
+    else
+    {
+        op.prepareSqe(sqe);
+    }
+
+    sqe->user_data = reinterpret_cast<__u64>(task);
+    task->inFlight = true;
+    task->inFlightKind = op.kind;
+
+    if(op.isBufferSelect())
+    {
+        task->bufferSelectOp = op;
+    }
+
+    if(op.hasLinkedTimeout())
+    {
+        sqe->flags |= IOSQE_IO_LINK;
+
+        struct io_uring_sqe *timeoutSqe = io_uring_get_sqe(&ring);
+        io_uring_prep_link_timeout(timeoutSqe, &task->opTimeout, 0);
+        timeoutSqe->user_data = LINK_TIMEOUT_USER_DATA;
+    }
+}
+
+void AIOUring::awaitMultishot(const AIOUringOp &op, AIOUringTask *task) {
+    if(task->multishotBacklog > 0)
+    {
+        auto completions = multishotCompletions.find(task);
+        MultishotCompletion completion = completions->second.front();
+
+        completions->second.pop_front();
+
+        if(--task->multishotBacklog == 0)
+        {
+            multishotCompletions.erase(completions);
+        }
+
+        if(completion.result == -ECANCELED)
+        {
+            task->cancelPending = false;
+        }
+
+        scheduleTask(task, completion.result, completion.flags);
+        return;
+    }
+
+    task->multishotWaiting = true;
+
+    if(task->multishotArmed)
+    {
+        return;
+    }
+
+    armMultishot(op, task);
+}
+
+void AIOUring::armMultishot(const AIOUringOp &op, AIOUringTask *task) {
+    struct io_uring_sqe *sqe = getSqe();
+
+    task->multishotOp = op;
+    task->multishotArmed = true;
+
+    if(sqe == nullptr)
+    {
+        deferredSqes.push_back(DeferredSqe{.op = op, .task = task});
+        ++ringStats.sqDeferred;
+        return;
+    }
+
+    op.prepareSqe(sqe);
+    sqe->user_data = reinterpret_cast<__u64>(task) | MULTISHOT_USER_DATA_TAG;
+}
+
+std::tuple<bool, int> AIOUring::completeMultishot(AIOUringTask *task, int ioResult, unsigned cqeFlags) {
+    if(!(cqeFlags & IORING_CQE_F_MORE))
+    {
+        task->multishotArmed = false;
+    }
+
+    // the buffer is out of the ring from now on, even while the completion waits in the backlog
+    holdCqeBuffer(task->multishotOp.bufferGroup, cqeFlags);
+
+    if(ioResult == -ENOBUFS && hasBufferGroup(task->multishotOp.bufferGroup) &&
+       !task->freePending && !task->cancelPending)
+    {
+        // the kernel stops the op once the group is empty, it is armed again when buffers are back
+        bufferGroups.at(static_cast<uint16_t>(task->multishotOp.bufferGroup))->noteExhausted();
+
+        if(task->multishotWaiting && !task->multishotArmed)
+        {
+            task->bufferWaiting = true;
+            bufferWaiters.push_back(task);
+        }
+
+        return std::make_tuple(true, 0);
+    }
+
+    if(task->freePending)
+    {
+        discardMultishotCompletion(task, ioResult, cqeFlags);
+
+        if(!task->multishotArmed && task->zeroCopyPending() == 0)
+        {
+            freeTask(task);
+        }
+
+        return std::make_tuple(true, 0);
+    }
+
+    if(!task->multishotWaiting)
+    {
+        multishotCompletions[task].push_back(MultishotCompletion{ioResult, cqeFlags});
+        ++task->multishotBacklog;
+        return std::make_tuple(true, 0);
+    }
+
+    task->multishotWaiting = false;
+
+    if(ioResult == -ECANCELED)
+    {
+        task->cancelPending = false;
+    }
+
+    selectCqeBuffer(task->multishotOp.bufferGroup, cqeFlags);
+
+    auto res = processTask(task, ioResult);
+
+    releaseCqeBuffer();
+
+    return res;
+}
+
+void AIOUring::completeZeroCopy(AIOUringTask *task) {
+    ++task->zeroCopyNotified;
+
+    // notifications come in the order of the sends of the socket
+    auto buffers = zeroCopyBuffers.find(task);
+
+    if(buffers != zeroCopyBuffers.end())
+    {
+        while(!buffers->second.empty() && buffers->second.front().first <= task->zeroCopyNotified)
+        {
+            buffers->second.pop_front();
+        }
+
+        if(buffers->second.empty())
+        {
+            zeroCopyBuffers.erase(buffers);
+        }
+    }
+
+    if(task->freePending)
+    {
+        if(task->zeroCopyPending() == 0 && !task->multishotArmed)
+        {
+            freeTask(task);
+        }
+    }
+    else if(task->zeroCopyWaiting && task->zeroCopyPending() <= task->zeroCopyKeep)
+    {
+        task->zeroCopyWaiting = false;
+        scheduleTask(task);
+    }
+}
+
+void AIOUring::releaseAfterZeroCopy(AIOUringTask *task, AIOUringBuffer buffer) {
+    while(task->parentTask != nullptr)
+    {
+        task = task->parentTask;
+    }
+
+    // without sends in flight the buffer goes back right away
+    if(task->zeroCopyPending() > 0)
+    {
+        zeroCopyBuffers[task].emplace_back(task->zeroCopySent, std::move(buffer));
+    }
+}
+
+void AIOUring::dropMultishotBacklog(AIOUringTask *task) {
+    auto completions = multishotCompletions.find(task);
+
+    if(completions == multishotCompletions.end())
+    {
+        return;
+    }
+
+    for(auto &completion : completions->second)
+    {
+        discardMultishotCompletion(task, completion.result, completion.flags);
+    }
+
+    multishotCompletions.erase(completions);
+    task->multishotBacklog = 0;
+}
+
+void AIOUring::discardMultishotCompletion(AIOUringTask *task, int ioResult, unsigned cqeFlags) {
+    recycleCqeBuffer(task->multishotOp.bufferGroup, cqeFlags);
+
+    // an accept completion nobody takes still carries a new socket
+    if(task->multishotOp.kind == AIOUringOp::Kind::AcceptMultishot && ioResult >= 0)
+    {
+        closeFd(task->multishotOp.len == IORING_FILE_INDEX_ALLOC
+                ? AIOUringOp::directFd(static_cast<unsigned>(ioResult)) : ioResult);
+    }
+}
+
+AIOUringTaskRef AIOUring::getTaskRef(AIOUringTask *task) {
+    if(!task->wakeable)
+    {
+        task->wakeable = true;
+        wakeableTasks.emplace(task->taskId, task);
+    }
+
+    return AIOUringTaskRef{task->taskId};
+}
+
+bool AIOUring::wake(AIOUringTaskRef ref) {
+    auto it = wakeableTasks.find(ref.taskId);
+
+    if(it == wakeableTasks.end())
+    {
+        return false;
+    }
+
+    AIOUringTask *task = it->second;
+
+    ++task->pendingWakes;
+
+    if(task->parked)
+    {
+        task->parked = false;
+        scheduleTask(task->wakeRoot);
+        task->wakeRoot = nullptr;
+    }
+
+    return true;
+}
+
+void AIOUring::parkTask(AIOUringTask *task, AIOUringTask *root) {
+    // a nested task parks through its top level task, which is the one to reschedule on wake
+    if(task->pendingWakes > 0)
+    {
+        scheduleTask(root);
+        return;
+    }
+
+    task->parked = true;
+    task->wakeRoot = root;
+}
+
+bool AIOUring::cancelTask(AIOUringTask *task) {
+    if(task == nullptr)
+    {
+        return false;
+    }
+
+    AIOUringTask *root = task;
+
+    for(AIOUringTask *child = task; child != nullptr; child = child->activeChild)
+    {
+        child->cancelled = true;
+    }
+
+    while(root->parentTask != nullptr)
+    {
+        root = root->parentTask;
+    }
+
+    // cleanup ops of finally() are never canceled
+    if(root->isTaskFinal())
+    {
+        return true;
+    }
+
+    root->cancelPending = true;
+
+    if(root->multishotArmed)
+    {
+        submitCancel(reinterpret_cast<__u64>(root) | MULTISHOT_USER_DATA_TAG);
+    }
+
+    if(root->inFlight)
+    {
+        // -ECANCELED comes with the completion of the op itself
+        submitCancel(reinterpret_cast<__u64>(root));
+        return true;
+    }
+
+    if(root->multishotWaiting)
+    {
+        // and with the last CQE of the multishot op
+        return true;
+    }
+
+    if(root->longTaskRunning)
+    {
+        // and with the completion of the job, which can't be stopped
+        return true;
+    }
+
+    bool waiting = root->timer.isArmed();
+
+    timerWheel.cancel(&root->timer);
+
+    if(root->bufferWaiting)
+    {
+        std::erase(bufferWaiters, root);
+        root->bufferWaiting = false;
+        root->multishotWaiting = false;
+        root->bufferSelectOp = AIOUringOp{};
+        waiting = true;
+    }
+
+    if(root->zeroCopyWaiting)
+    {
+        // the notifications still release the buffers, the task just stops waiting for them
+        root->zeroCopyWaiting = false;
+        waiting = true;
+    }
+
+    for(AIOUringTask *child = root; child != nullptr; child = child->activeChild)
+    {
+        if(child->parked)
+        {
+            child->parked = false;
+            child->wakeRoot = nullptr;
+            waiting = true;
+        }
+    }
+
+    if(waiting)
+    {
+        root->cancelPending = false;
+        scheduleTask(root, -ECANCELED);
+    }
+
+    return true;
+}
+
+void AIOUring::submitCancel(__u64 userData) {
+    struct io_uring_sqe *sqe = getSqe();
+
+    if(sqe == nullptr)
+    {
+        deferredSqes.push_back(DeferredSqe{.cancelUserData = userData});
+        ++ringStats.sqDeferred;
+        return;
+    }
+
+    io_uring_prep_cancel64(sqe, userData, 0);
+    sqe->user_data = CANCEL_USER_DATA;
+}
+
+bool AIOUring::cancelTask(AIOUringTaskRef ref) {
+    auto it = wakeableTasks.find(ref.taskId);
+
+    return it != wakeableTasks.end() && cancelTask(it->second);
+}
+
+void AIOUring::sleepTask(AIOUringTask *task, AIOUringTimerWheel::Clock::time_point deadline) {
+    task->timer.owner = task;
+
+    if(!timerWheel.arm(&task->timer, deadline))
+    {
+        scheduleTask(task, -ETIME);
+    }
+}
+
+void AIOUring::expireTimers() {
+    timerWheel.expire(AIOUringTimerWheel::Clock::now(), [this](AIOUringTimer *timer) {
+        scheduleTask(static_cast<AIOUringTask *>(timer->owner), -ETIME);
+    });
+}
+
+int AIOUring::submitAndWait() {
+    // don't block in the kernel while there are tasks ready to be polled
+    if(readyCount > 0)
+    {
+        // with DEFER_TASKRUN completions are posted only by an enter with GETEVENTS
+        return setupOptions.deferTaskrun ? io_uring_submit_and_get_events(&ring)
+                                         : io_uring_submit_and_wait(&ring, 0);
+    }
+
+    auto nextExpiry = timerWheel.nextExpiry();
+
+    if(balancer != nullptr)
+    {
+        // an idle ring still samples its load and looks for work to steal
+        auto nextSample = loadMeter.nextSample(balancer->getOptions().sampleInterval);
+
+        nextExpiry = nextExpiry.has_value() ? std::min(*nextExpiry, nextSample) : nextSample;
+    }
+
+    if(!nextExpiry.has_value())
+    {
+        return io_uring_submit_and_wait(&ring, 1);
+    }
+
+    // the nearest timer bounds the wait, all timers share this single deadline
+    auto waitTime = std::max(*nextExpiry - AIOUringTimerWheel::Clock::now(),
+                             AIOUringTimerWheel::Clock::duration::zero());
+    auto waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(waitTime).count();
+    __kernel_timespec waitTimeout {
+            .tv_sec = waitNs / 1000000000,
+            .tv_nsec = waitNs % 1000000000
+    };
+    struct io_uring_cqe *cqe;
+
+    auto result = io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &waitTimeout, nullptr);
+
+    return result == -ETIME ? 0 : result;
+}
+
+void AIOUring::armWakeup() {
+    struct io_uring_sqe *sqe = getSqe();
+
+    if(sqe == nullptr)
+    {
+        wakeupDeferred = true;
+        return;
+    }
+
+    io_uring_prep_read(sqe, wakeupfd, &wakeupSink, sizeof(eventfd_t), 0);
+    sqe->user_data = WAKEUP_USER_DATA;
+}
+
+io_uring_sqe *AIOUring::getSqe(unsigned count) {
+    if(io_uring_sq_space_left(&ring) < count)
+    {
+        ++ringStats.sqFull;
+
+        // without SQPOLL the kernel consumes the whole SQ during the submit
+        io_uring_submit(&ring);
+
+        if(setupOptions.sqPoll && io_uring_sq_space_left(&ring) < count)
+        {
+            io_uring_sqring_wait(&ring);
+        }
+
+        if(io_uring_sq_space_left(&ring) < count)
+        {
+            return nullptr;
+        }
+    }
+
+    return io_uring_get_sqe(&ring);
+}
+
+void AIOUring::flushDeferredSqes() {
+    if(wakeupDeferred)
+    {
+        wakeupDeferred = false;
+        armWakeup();
+    }
+
+    while(!deferredSqes.empty() && !wakeupDeferred)
+    {
+        DeferredSqe deferred = deferredSqes.front();
+
+        if(io_uring_sq_space_left(&ring) < (deferred.op.hasLinkedTimeout() ? 2u : 1u))
+        {
+            // still full, the rest waits for the next iteration
+            return;
+        }
+
+        deferredSqes.pop_front();
+
+        AIOUringTask *task = deferred.task;
+
+        if(task == nullptr)
+        {
+            submitCancel(deferred.cancelUserData);
+        }
+        else if(deferred.op.isMultishot())
+        {
+            task->multishotArmed = false;
+
+            if(task->freePending)
+            {
+                if(task->zeroCopyPending() == 0)
+                {
+                    freeTask(task);
+                }
+            }
+            else if(task->cancelPending)
+            {
+                task->cancelPending = false;
+                task->multishotWaiting = false;
+                scheduleTask(task, -ECANCELED);
+            }
+            else
+            {
+                armMultishot(deferred.op, task);
+            }
+        }
+        else
+        {
+            task->inFlight = false;
+
+            if(task->cancelPending)
+            {
+                task->cancelPending = false;
+                scheduleTask(task, -ECANCELED);
+            }
+            else
+            {
+                submitOp(deferred.op, task);
+            }
+        }
+    }
+}
+
+void AIOUring::checkCqOverflow() {
+    bool overflow = io_uring_cq_has_overflow(&ring);
+
+    if(overflow && !cqOverflow)
+    {
+        ++ringStats.cqOverflows;
+        kklogging::WARN(fmt::format("Ring {}: CQ overflow, completions wait in the kernel. "
+                                    "CQ size {} is too small for the load.", instanceId, params.cq_entries));
+    }
+
+    cqOverflow = overflow;
+
+    unsigned dropped = __atomic_load_n(ring.cq.koverflow, __ATOMIC_RELAXED);
+
+    if(dropped != ringStats.cqDropped)
+    {
+        kklogging::ERROR(fmt::format("Ring {}: the kernel dropped {} CQEs.", instanceId, dropped - ringStats.cqDropped));
+        ringStats.cqDropped = dropped;
+    }
+}
+
+AIOUringRingStats AIOUring::getRingStats() const {
+    AIOUringRingStats stats = ringStats;
+
+    stats.sqBacklog = deferredSqes.size();
+
+    return stats;
+}
+
+AIOUringLongTaskStats AIOUring::getLongTaskStats() const {
+    AIOUringLongTaskStats stats = longTaskStats;
+
+    stats.wakeups = longTaskWakeups.load(std::memory_order_relaxed);
+
+    if(stats.completed > 0)
+    {
+        stats.queueWaitAvgNs = longTaskQueueWaitSumNs / stats.completed;
+        stats.resumeLatencyAvgNs = longTaskResumeLatencySumNs / stats.completed;
+    }
+
+    return stats;
+}
+
+std::vector<AIOUringTaskPoolStats> AIOUring::getTaskPoolStats() const {
+    std::vector<AIOUringTaskPoolStats> stats{};
+
+    for(auto &pool : taskPools)
+    {
+        if(pool != nullptr)
+        {
+            stats.push_back(pool->getStats());
+        }
+    }
+
+    return stats;
+}
+
+std::vector<AIOUringTaskPoolStats> AIOUring::getFramePoolStats() const {
+    return frameAllocator.getStats();
+}
+
+int AIOUring::getInstanceId() const {
+    return instanceId;
+}
+
+int AIOUring::getRingFd() const {
+    return ring.ring_fd;
 }
 
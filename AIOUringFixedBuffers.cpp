@@ -0,0 +1,121 @@
+#include "include/aiouring/AIOUringFixedBuffers.h"
+#include "include/aiouring/AIOUring.h"
+
+#include <algorithm>
+#include <sys/uio.h>
+
+AIOUringFixedBuffer::AIOUringFixedBuffer(AIOUringFixedBuffers *buffers, unsigned bufferIndex) :
+        buffers{buffers}, bufferIndex{bufferIndex} {
+
+}
+
+AIOUringFixedBuffer::AIOUringFixedBuffer(AIOUringFixedBuffer &&other) noexcept :
+        buffers{std::exchange(other.buffers, nullptr)}, bufferIndex{other.bufferIndex} {
+
+}
+
+AIOUringFixedBuffer &AIOUringFixedBuffer::operator=(AIOUringFixedBuffer &&other) noexcept {
+    if(this != &other)
+    {
+        release();
+        buffers = std::exchange(other.buffers, nullptr);
+        bufferIndex = other.bufferIndex;
+    }
+
+    return *this;
+}
+
+AIOUringFixedBuffer::~AIOUringFixedBuffer() {
+    release();
+}
+
+char *AIOUringFixedBuffer::data() const {
+    return buffers != nullptr ? buffers->bufferData(bufferIndex) : nullptr;
+}
+
+size_t AIOUringFixedBuffer::size() const {
+    return buffers != nullptr ? buffers->getBufferSize() : 0;
+}
+
+void AIOUringFixedBuffer::release() {
+    if(buffers != nullptr)
+    {
+        std::exchange(buffers, nullptr)->recycle(bufferIndex);
+    }
+}
+
+AIOUringFixedBuffers::AIOUringFixedBuffers(io_uring *ring, unsigned buffers, size_t bufferSize) :
+        ring{ring}, buffers{buffers}, bufferSize{bufferSize} {
+    if(buffers == 0 || bufferSize == 0)
+    {
+        throw AIOUringException(fmt::format("Fixed buffers: {} buffers of {} bytes requested.", buffers, bufferSize));
+    }
+
+    memory = std::make_unique<char[]>(buffers * bufferSize);
+
+    std::vector<iovec> iovecs(buffers);
+
+    for(unsigned bufferIndex = 0; bufferIndex < buffers; ++bufferIndex)
+    {
+        iovecs[bufferIndex] = iovec{bufferData(bufferIndex), bufferSize};
+    }
+
+    auto result = io_uring_register_buffers(ring, iovecs.data(), buffers);
+
+    if(result < 0)
+    {
+        throw AIOUringException(fmt::format("Fixed buffers: io_uring_register_buffers failed: {}",
+                                            aioutils::uexcept::errnoStr(-result)));
+    }
+
+    // leased from the back, lower indexes first
+    freeBuffers.reserve(buffers);
+
+    for(unsigned bufferIndex = buffers; bufferIndex > 0; --bufferIndex)
+    {
+        freeBuffers.push_back(bufferIndex - 1);
+    }
+}
+
+AIOUringFixedBuffers::~AIOUringFixedBuffers() {
+    io_uring_unregister_buffers(ring);
+}
+
+AIOUringFixedBuffer AIOUringFixedBuffers::lease() {
+    if(freeBuffers.empty())
+    {
+        ++exhausted;
+        return AIOUringFixedBuffer{};
+    }
+
+    unsigned bufferIndex = freeBuffers.back();
+
+    freeBuffers.pop_back();
+    ++leased;
+    highWater = std::max(highWater, buffers - freeBuffers.size());
+
+    return AIOUringFixedBuffer{this, bufferIndex};
+}
+
+void AIOUringFixedBuffers::recycle(unsigned bufferIndex) {
+    freeBuffers.push_back(bufferIndex);
+}
+
+char *AIOUringFixedBuffers::bufferData(unsigned bufferIndex) const {
+    return memory.get() + static_cast<size_t>(bufferIndex) * bufferSize;
+}
+
+size_t AIOUringFixedBuffers::getBufferSize() const {
+    return bufferSize;
+}
+
+AIOUringFixedBufferStats AIOUringFixedBuffers::getStats() const {
+    return AIOUringFixedBufferStats {
+            .bufferSize = bufferSize,
+            .buffers = buffers,
+            .inUse = buffers - freeBuffers.size(),
+            .highWater = highWater,
+            .leased = leased,
+            .exhausted = exhausted
+    };
+}
@@ -0,0 +1,304 @@
+#include "include/aiouring/AIOUringRuntime.h"
+
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace aioutils;
+
+AIOUringRuntime::AIOUringRuntime(unsigned threadsNumber, bool useSQPoll, bool pinThreads) :
+        AIOUringRuntime{threadsNumber, threadOptions(AIOUringSetupOptions{.sqPoll = useSQPoll}), pinThreads} {
+
+}
+
+AIOUringRuntime::AIOUringRuntime(unsigned threadsNumber, AIOUringSetupOptions setupOptions, bool pinThreads) :
+        threadsNumber{threadsNumber}, setupOptions{setupOptions}, pinThreads{pinThreads} {
+    if(this->threadsNumber == 0)
+    {
+        this->threadsNumber = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+AIOUringSetupOptions AIOUringRuntime::threadOptions(AIOUringSetupOptions setupOptions) {
+    setupOptions.deferTaskrun = true;
+    setupOptions.coopTaskrun = true;
+    setupOptions.registerRingFd = true;
+
+    return setupOptions;
+}
+
+void AIOUringRuntime::onEachRing(RingInitializer initializer) {
+    initializers.push_back(std::move(initializer));
+}
+
+void AIOUringRuntime::setBalanceOptions(std::optional<AIOUringBalanceOptions> options) {
+    balanceOptions = options;
+}
+
+unsigned AIOUringRuntime::getThreadsNumber() const {
+    return threadsNumber;
+}
+
+AIOUring *AIOUringRuntime::getRing(unsigned index) {
+    std::lock_guard<std::mutex> lock{ringsMutex};
+
+    return index < rings.size() ? rings[index].get() : nullptr;
+}
+
+void AIOUringRuntime::broadcast(AIOUring *from, const AIOUringMessage &message) {
+    if(message.fd >= 0)
+    {
+        throw AIOUringException("A message with an fd can't be broadcast.");
+    }
+
+    std::vector<AIOUring *> targets{};
+
+    {
+        std::lock_guard<std::mutex> lock{ringsMutex};
+
+        for(auto &aioUring : rings)
+        {
+            if(aioUring != nullptr && aioUring.get() != from)
+            {
+                targets.push_back(aioUring.get());
+            }
+        }
+    }
+
+    // sendTo() may wait for room in the SQ, the rings live until the next run()
+    for(auto target : targets)
+    {
+        from->sendTo(target, message);
+    }
+}
+
+std::vector<AIOUringLoad> AIOUringRuntime::getLoads() {
+    std::lock_guard<std::mutex> lock{ringsMutex};
+
+    return balancer != nullptr ? balancer->getLoads() : std::vector<AIOUringLoad>{};
+}
+
+void AIOUringRuntime::stop(int code) {
+    std::lock_guard<std::mutex> lock{ringsMutex};
+
+    if(!stopped)
+    {
+        stopped = true;
+        stoppedCode = code;
+    }
+
+    for(auto &aioUring : rings)
+    {
+        if(aioUring != nullptr)
+        {
+            aioUring->stop(stoppedCode);
+        }
+    }
+}
+
+int AIOUringRuntime::run() {
+    {
+        std::lock_guard<std::mutex> lock{ringsMutex};
+        rings.clear();
+        rings.resize(threadsNumber);
+        balancer = balanceOptions.has_value() && threadsNumber > 1
+                   ? std::make_unique<AIOUringBalancer>(threadsNumber, *balanceOptions) : nullptr;
+        stopped = false;
+        stoppedCode = 0;
+        cpus = allowedCpus();
+    }
+
+    std::promise<int> backendPromise{};
+    std::shared_future<int> backendFuture = backendPromise.get_future().share();
+    std::vector<int> exitCodes(threadsNumber, EXIT_SUCCESS);
+    std::vector<std::thread> threads{};
+
+    threads.reserve(threadsNumber);
+
+    for(unsigned index = 0; index < threadsNumber; ++index)
+    {
+        threads.emplace_back([&, index]() {
+            std::optional<int> backendRingFd{std::nullopt};
+
+            if(index > 0)
+            {
+                // the first ring creates the kernel worker pool, others attach to it
+                backendRingFd = backendFuture.get();
+
+                if(*backendRingFd < 0)
+                {
+                    exitCodes[index] = EXIT_FAILURE;
+                    return;
+                }
+            }
+
+            exitCodes[index] = runRing(index, backendRingFd, index == 0 ? &backendPromise : nullptr);
+
+            stop(exitCodes[index]);
+        });
+    }
+
+    for(auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock{ringsMutex};
+
+    if(stoppedCode != EXIT_SUCCESS)
+    {
+        return stoppedCode;
+    }
+
+    for(auto exitCode : exitCodes)
+    {
+        if(exitCode != EXIT_SUCCESS)
+        {
+            return exitCode;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int AIOUringRuntime::runRing(unsigned index, std::optional<int> backendRingFd,
+                             std::promise<int> *backendPromise) {
+    AIOUring *aioUring{nullptr};
+
+    try
+    {
+        if(pinThreads)
+        {
+            pinThread(index);
+        }
+
+        auto newRing = std::make_unique<AIOUring>(backendRingFd, ringOptions(index));
+
+        newRing->setup();
+
+        {
+            std::lock_guard<std::mutex> lock{ringsMutex};
+            aioUring = newRing.get();
+            rings[index] = std::move(newRing);
+
+            if(stopped)
+            {
+                aioUring->stop(stoppedCode);
+            }
+        }
+
+        if(backendPromise != nullptr)
+        {
+            backendPromise->set_value(aioUring->getRingFd());
+            backendPromise = nullptr;
+        }
+
+        for(auto &initializer : initializers)
+        {
+            initializer(aioUring);
+        }
+
+        if(balancer != nullptr)
+        {
+            balancer->attach(index, aioUring);
+        }
+
+        kklogging::INFO(fmt::format("Ring {} has been started on thread {}.",
+                                    aioUring->getInstanceId(), index));
+
+        auto exitCode = aioUring->run();
+
+        if(balancer != nullptr)
+        {
+            balancer->detach(index);
+        }
+
+        return exitCode;
+    }
+    catch(std::exception &e)
+    {
+        kklogging::ERROR(fmt::format("Ring on thread {}: {}", index, e.what()));
+
+        if(backendPromise != nullptr)
+        {
+            backendPromise->set_value(-1);
+        }
+
+        return EXIT_FAILURE;
+    }
+}
+
+void AIOUringRuntime::pinThread(unsigned index) const {
+    unsigned cpu = cpus[index % cpus.size()];
+    cpu_set_t cpuSet;
+
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+
+    auto result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+
+    if(result != 0)
+    {
+        kklogging::WARN(fmt::format("Failed to pin thread {} to cpu {}: {}",
+                                    index, cpu, uexcept::errnoStr(result)));
+    }
+}
+
+AIOUringSetupOptions AIOUringRuntime::ringOptions(unsigned index) const {
+    AIOUringSetupOptions options = setupOptions;
+
+    options.lockedMemoryShares = threadsNumber;
+
+    if(!options.sqThreadCpu.has_value())
+    {
+        return options;
+    }
+
+    auto first = std::find(cpus.begin(), cpus.end(), *options.sqThreadCpu);
+
+    if(first == cpus.end())
+    {
+        kklogging::WARN(fmt::format("Ring on thread {}: sq thread cpu {} isn't in the affinity mask "
+                                    "of the process.", index, *options.sqThreadCpu));
+        return options;
+    }
+
+    // one SQPOLL thread per cpu, starting from the configured one
+    auto position = static_cast<size_t>(first - cpus.begin());
+
+    options.sqThreadCpu = cpus[(position + index) % cpus.size()];
+
+    return options;
+}
+
+std::vector<unsigned> AIOUringRuntime::allowedCpus() {
+    std::vector<unsigned> allowed{};
+    cpu_set_t cpuSet;
+
+    CPU_ZERO(&cpuSet);
+
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &cpuSet) == 0)
+    {
+        for(unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if(CPU_ISSET(cpu, &cpuSet))
+            {
+                allowed.push_back(cpu);
+            }
+        }
+    }
+    else
+    {
+        kklogging::WARN(fmt::format("sched_getaffinity failed: {}", uexcept::errnoStr(errno)));
+    }
+
+    if(allowed.empty())
+    {
+        for(unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+        {
+            allowed.push_back(cpu);
+        }
+    }
+
+    return allowed;
+}
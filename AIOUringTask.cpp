@@ -4,9 +4,10 @@
 
 #include "include/aiouring/AIOUringTask.h"
 
-AIOUringTask::AIOUringTask() {
-    taskfd = std::make_shared<int>(eventfd(0, EFD_SEMAPHORE));
-}
+#include <cerrno>
+#include <cstring>
+
+AIOUringTask::AIOUringTask() = default;
 
 void AIOUringTask::setUringId(int id) {
     uringId = id;
@@ -16,7 +17,14 @@ int AIOUringTask::getUringId() const {
     return uringId;
 }
 
-std::weak_ptr<int> AIOUringTask::getTaskfd() const {
+int AIOUringTask::getEventfd() {
+    if(taskfd < 0) {
+        taskfd = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
+
+        if(taskfd < 0) {
+            throw IOUringTaskException(std::string{"Failed to create eventfd: "} + std::strerror(errno));
+        }
+    }
     return taskfd;
 }
 
@@ -33,8 +41,9 @@ bool AIOUringTask::init() {
 }
 
 void AIOUringTask::free() {
-    if(*taskfd > 0) {
-        close(*taskfd);
+    if(taskfd >= 0) {
+        close(taskfd);
+        taskfd = -1;
     }
 }
 
@@ -50,19 +59,29 @@ AIOUringTask::TaskFuture AIOUringTask::futureOp(AIOUringOp op) {
     return std::make_tuple(std::optional{op}, std::nullopt);
 }
 
-AIOUringTask::TaskFuture AIOUringTask::futureResult(std::any result) {
-    return std::make_tuple(std::nullopt, std::optional{result});
+AIOUringTask::TaskFuture AIOUringTask::futureError(int code, std::string_view message) {
+    TaskFuture future{std::nullopt, AIOUringTaskError{.code = code}};
+    auto length = std::min(message.size(), AIOUringTaskError::textSize - 1);
+
+    message.copy(std::get<1>(future)->text, length);
+
+    return future;
 }
 
 void AIOUringTask::setUring(io_uring *newRing) {
     ring = newRing;
 }
 
-void AIOUringTask::setClassName(std::string className) {
-    this->className = std::move(className);
+void AIOUringTask::setTaskType(size_t typeId, std::string_view name) {
+    taskTypeId = typeId;
+    className = name;
+}
+
+size_t AIOUringTask::getTaskTypeId() const {
+    return taskTypeId;
 }
 
-std::string AIOUringTask::getClassName() const {
+std::string_view AIOUringTask::getClassName() const {
     return className;
 }
 
@@ -78,3 +97,20 @@ void AIOUringTask::setTaskFinal() {
 bool AIOUringTask::isTaskFinal() {
     return finalization;
 }
+
+bool AIOUringTask::isCancelled() const {
+    return cancelled;
+}
+
+void AIOUringTask::attachChild(AIOUringTask *child) {
+    activeChild = child;
+    child->parentTask = this;
+}
+
+bool AIOUringTask::consumeWake() {
+    if(pendingWakes == 0) {
+        return false;
+    }
+    --pendingWakes;
+    return true;
+}
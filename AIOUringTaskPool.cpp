@@ -0,0 +1,87 @@
+#include "include/aiouring/AIOUringTaskPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+
+std::string AIOUringTaskTypes::demangle(const char *mangledName) {
+    int status;
+    char *demangled = abi::__cxa_demangle(mangledName, nullptr, nullptr, &status);
+
+    if(demangled == nullptr)
+    {
+        return mangledName;
+    }
+
+    std::string result{demangled};
+    std::free(demangled);
+
+    return result;
+}
+
+AIOUringTaskPool::AIOUringTaskPool(size_t typeId, std::string_view className,
+                                   size_t objectSize, size_t objectAlign) {
+    blockAlign = std::max(objectAlign, alignof(FreeBlock));
+    blockSize = std::max(objectSize, sizeof(FreeBlock));
+    blockSize = (blockSize + blockAlign - 1) / blockAlign * blockAlign;
+    blocksPerSlab = std::clamp(slabBytes / blockSize, size_t{1}, maxBlocksPerSlab);
+
+    stats.typeId = typeId;
+    stats.className = className;
+    stats.objectSize = objectSize;
+}
+
+AIOUringTaskPool::~AIOUringTaskPool() {
+    for(auto slab : slabs)
+    {
+        ::operator delete(slab, std::align_val_t{blockAlign});
+    }
+}
+
+void *AIOUringTaskPool::acquire() {
+    if(freeBlocks == nullptr)
+    {
+        grow();
+    }
+    else
+    {
+        ++stats.recycled;
+    }
+
+    FreeBlock *block = freeBlocks;
+    freeBlocks = block->next;
+
+    ++stats.acquired;
+    ++stats.live;
+    stats.highWater = std::max(stats.highWater, stats.live);
+
+    return block;
+}
+
+void AIOUringTaskPool::release(void *block) {
+    auto freeBlock = static_cast<FreeBlock *>(block);
+    freeBlock->next = freeBlocks;
+    freeBlocks = freeBlock;
+
+    --stats.live;
+}
+
+const AIOUringTaskPoolStats &AIOUringTaskPool::getStats() const {
+    return stats;
+}
+
+void AIOUringTaskPool::grow() {
+    auto slab = static_cast<std::byte *>(::operator new(blockSize * blocksPerSlab, std::align_val_t{blockAlign}));
+
+    slabs.push_back(slab);
+
+    for(size_t i = blocksPerSlab; i > 0; --i)
+    {
+        auto block = reinterpret_cast<FreeBlock *>(slab + (i - 1) * blockSize);
+        block->next = freeBlocks;
+        freeBlocks = block;
+    }
+
+    stats.capacity += blocksPerSlab;
+    stats.slabs = slabs.size();
+}
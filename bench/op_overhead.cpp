@@ -0,0 +1,149 @@
+// Per-op overhead of handing an io_uring op from a task to the ring: the descriptor
+// AIOUringOp filled into an SQE by prepareSqe() against the std::function factory it
+// replaced, both returned through a TaskFuture shaped tuple. No ring is created, the SQE
+// lives on the stack, so only the liburing headers are needed.
+
+#include "aiouring/AIOUringOp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+#include <string>
+#include <tuple>
+
+namespace {
+
+// error slot of the futures, the same for both paths
+struct BenchError {
+    int code{0};
+    std::string message{};
+};
+
+// AIOUringOp before the descriptor: a closure which writes the SQE
+struct LegacyOp {
+    std::optional<std::function<void(io_uring_sqe *, __u64)>> submit{std::nullopt};
+    bool shutdown{false};
+    int shutdownCode{0};
+    bool yield{false};
+};
+
+using LegacyFuture = std::tuple<std::optional<LegacyOp>, std::optional<BenchError>>;
+using OpFuture = std::tuple<std::optional<AIOUringOp>, std::optional<BenchError>>;
+
+// the factories lived in AIOUringOp.cpp, out of reach of the inliner of the task
+[[gnu::noinline]] LegacyOp legacyRead(int fd, void *buf, size_t bufSize, __u64 offset) {
+    return LegacyOp {
+            .submit = [=](io_uring_sqe *sqe, __u64 userData) {
+                io_uring_prep_read(sqe, fd, buf, static_cast<unsigned>(bufSize), offset);
+                sqe->user_data = userData;
+            }
+    };
+}
+
+[[gnu::noinline]] LegacyOp legacyWrite(int fd, void *buf, size_t bufSize, __u64 offset) {
+    return LegacyOp {
+            .submit = [=](io_uring_sqe *sqe, __u64 userData) {
+                io_uring_prep_write(sqe, fd, buf, static_cast<unsigned>(bufSize), offset);
+                sqe->user_data = userData;
+            }
+    };
+}
+
+[[gnu::noinline]] LegacyOp legacyRecv(int fd, void *buf, size_t bufSize, int flags) {
+    return LegacyOp {
+            .submit = [=](io_uring_sqe *sqe, __u64 userData) {
+                io_uring_prep_recv(sqe, fd, buf, bufSize, flags);
+                sqe->user_data = userData;
+            }
+    };
+}
+
+// stands for TaskFuture poll(int io_result) of a task
+[[gnu::noinline]] LegacyFuture legacyPoll(uint64_t step, char *buffer) {
+    switch(step % 3) {
+        case 0:
+            return std::make_tuple(std::optional{legacyRead(3, buffer, 16384, 0)}, std::nullopt);
+        case 1:
+            return std::make_tuple(std::optional{legacyWrite(4, buffer, 16384, 0)}, std::nullopt);
+        default:
+            return std::make_tuple(std::optional{legacyRecv(5, buffer, 16384, 0)}, std::nullopt);
+    }
+}
+
+[[gnu::noinline]] OpFuture opPoll(uint64_t step, char *buffer) {
+    switch(step % 3) {
+        case 0:
+            return std::make_tuple(std::optional{AIOUringOp::Read(3, buffer, 16384)}, std::nullopt);
+        case 1:
+            return std::make_tuple(std::optional{AIOUringOp::Write(4, buffer, 16384)}, std::nullopt);
+        default:
+            return std::make_tuple(std::optional{AIOUringOp::Recv(5, buffer, 16384)}, std::nullopt);
+    }
+}
+
+template<typename F>
+double nsPerOp(uint64_t iterations, F &&submitOne) {
+    auto start = std::chrono::steady_clock::now();
+
+    for(uint64_t step = 0; step < iterations; ++step)
+    {
+        submitOne(step);
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    return elapsed.count() / static_cast<double>(iterations);
+}
+
+}
+
+int main(int argc, char **argv) {
+    uint64_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+    char buffer[64]{};
+    io_uring_sqe sqe{};
+    uint64_t sink = 0;
+
+    auto legacy = [&](uint64_t step) {
+        LegacyFuture future = legacyPoll(step, buffer);
+        (*std::get<0>(future)->submit)(&sqe, step);
+        sink += sqe.len + sqe.opcode;
+    };
+
+    auto descriptor = [&](uint64_t step) {
+        OpFuture future = opPoll(step, buffer);
+        std::get<0>(future)->prepareSqe(&sqe);
+        sqe.user_data = step;
+        sink += sqe.len + sqe.opcode;
+    };
+
+    std::printf("sizeof(LegacyOp) = %zu, sizeof(AIOUringOp) = %zu\n", sizeof(LegacyOp), sizeof(AIOUringOp));
+    std::printf("sizeof(LegacyFuture) = %zu, sizeof(OpFuture) = %zu\n", sizeof(LegacyFuture), sizeof(OpFuture));
+
+    // warm up the allocator and the branch predictors
+    nsPerOp(iterations / 10, legacy);
+    nsPerOp(iterations / 10, descriptor);
+
+    double legacyBest = 0;
+    double descriptorBest = 0;
+
+    for(int round = 0; round < rounds; ++round)
+    {
+        double legacyNs = nsPerOp(iterations, legacy);
+        double descriptorNs = nsPerOp(iterations, descriptor);
+
+        legacyBest = round == 0 ? legacyNs : std::min(legacyBest, legacyNs);
+        descriptorBest = round == 0 ? descriptorNs : std::min(descriptorBest, descriptorNs);
+
+        std::printf("round %d: std::function %.2f ns/op, AIOUringOp %.2f ns/op\n", round, legacyNs, descriptorNs);
+    }
+
+    std::printf("best: std::function %.2f ns/op, AIOUringOp %.2f ns/op, %.1fx\n",
+                legacyBest, descriptorBest, legacyBest / descriptorBest);
+
+    // keeps the SQE writes alive
+    return sink == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
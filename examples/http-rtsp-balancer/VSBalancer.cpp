@@ -1,6 +1,7 @@
 #include <mimalloc-new-delete.h>
 #include <fmt/core.h>
 #include <aiouring/AIOUring.h>
+#include <aiouring/AIOUringRuntime.h>
 #include <kklogging/kklogging.h>
 #include <aioutils/uexcept.h>
 #include <aioutils/utext.h>
@@ -55,13 +56,32 @@ int main() {
 
     try
     {
-        AIOUring aioUring{};
-
-        aioUring.setup();
+        auto config = vsbconfig::getConfig();
+
+        // one pool for the blocking calls of all rings
+        AIOUringBlockingPool::configureShared(AIOUringBlockingPoolOptions {
+                .threads = static_cast<size_t>(config.blockingThreads),
+                .maxQueued = static_cast<size_t>(config.blockingMaxQueued)
+        });
+        AIOUringBlockingPool::shared().setCategory("postgresql", AIOUringBlockingCategoryLimits {
+                .maxInFlight = static_cast<size_t>(config.postgresqlMaxInFlight)
+        });
+
+        AIOUringRuntime runtime{static_cast<unsigned>(config.threads), AIOUringRuntime::threadOptions(AIOUringSetupOptions {
+                .sqEntries = static_cast<unsigned>(config.sqEntries),
+                .cqEntries = static_cast<unsigned>(config.cqEntries)
+        })};
+
+        if(!config.balanceRings) {
+            runtime.setBalanceOptions(std::nullopt);
+        }
 
-        aioUring.pushTask(aioUring.newTask<MainTask>(&aioUring));
+        runtime.onEachRing([](AIOUring *aioUring) {
+            aioUring->setZeroCopyThreshold(static_cast<size_t>(vsbconfig::getConfig().zeroCopyThreshold));
+        });
+        runtime.pushTaskOnEach<MainTask>();
 
-        return aioUring.run();
+        return runtime.run();
     }
     catch(std::exception &e)
     {
@@ -87,6 +107,17 @@ bool configure() {
     kklogging::INFO("Defaults have been set to: ");
     kklogging::INFO(fmt::format("port={}", config.port));
     kklogging::INFO(fmt::format("maxBacklog={}", config.maxBacklog));
+    kklogging::INFO(fmt::format("threads={}", config.threads));
+    kklogging::INFO(fmt::format("connectTimeoutMs={}", config.connectTimeoutMs));
+    kklogging::INFO(fmt::format("clientReadTimeoutMs={}", config.clientReadTimeoutMs));
+    kklogging::INFO(fmt::format("zeroCopyThreshold={}", config.zeroCopyThreshold));
+    kklogging::INFO(fmt::format("spliceRelay={}", config.spliceRelay));
+    kklogging::INFO(fmt::format("sqEntries={}", config.sqEntries));
+    kklogging::INFO(fmt::format("cqEntries={}", config.cqEntries));
+    kklogging::INFO(fmt::format("blockingThreads={}", config.blockingThreads));
+    kklogging::INFO(fmt::format("blockingMaxQueued={}", config.blockingMaxQueued));
+    kklogging::INFO(fmt::format("postgresqlMaxInFlight={}", config.postgresqlMaxInFlight));
+    kklogging::INFO(fmt::format("balanceRings={}", config.balanceRings));
     kklogging::INFO("Redirects:");
     for(auto &r : config.redirects) {
         kklogging::INFO(fmt::format("name: {}", r.name));
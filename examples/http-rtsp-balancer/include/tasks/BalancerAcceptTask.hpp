@@ -10,9 +10,11 @@
 #include <aiouring/tasks/TCPConnectTask.hpp>
 #include <aiouring/tasks/TCPInterweaveTask.hpp>
 #include <aiouring/tasks/TCPShutAndClose.hpp>
+#include <aiouring/tasks/TCPWritev.hpp>
 #include <utility>
 #include <aioutils/uhttp.hpp>
 
+#include "vsbconfig.hpp"
 #include "tasks/FindTargetTask.hpp"
 #include "tasks/SendBalancerResponse.hpp"
 #include "tasks/RTSPInterweaveTask.hpp"
@@ -28,11 +30,24 @@ public:
     TaskFuture poll(int io_result) override {
         ASYNC_IO;
 
-        AWAIT_OP(Read, readClient, clientSocket, opBuffer.data(), opBuffer.size());
+        if(aioUring->getReadBufferGroup() < 0) {
+            // no provided buffers in the kernel
+            opBuffer.resize(4096);
+        }
+
+        AWAIT_OP_TIMEOUT(ReadSelect, readClient,
+                         std::chrono::milliseconds{vsbconfig::MainConfiguration::instance().clientReadTimeoutMs},
+                         clientSocket, aioUring->getReadBufferGroup(), opBuffer.data(), opBuffer.size());
+
+        if(io_result == -ECANCELED)
+        {
+            kklogging::INFO("BalancerAcceptTask: exit due to client read timeout.");
+            return TASK_RESULT_NONE();
+        }
 
         if(io_result < 0)
         {
-            return TASK_ERROR(fmt::format("Failed to read TCP: {}", std::string(strerror(-io_result))));
+            return TASK_ERROR("Failed to read TCP: {}", strerror(-io_result));
         }
 
         if(io_result == 0)
@@ -41,7 +56,12 @@ public:
             return TASK_RESULT_NONE();
         }
 
-        tcpBuffer.insert(tcpBuffer.end(), opBuffer.begin(), opBuffer.begin() + io_result);
+        {
+            AIOUringBuffer chunk = aioUring->takeBuffer(io_result);
+            const char *data = chunk ? chunk.data() : opBuffer.data();
+
+            tcpBuffer.insert(tcpBuffer.end(), data, data + io_result);
+        }
 
         tcpBufferView = std::string_view{tcpBuffer.begin(), tcpBuffer.end()};
 
@@ -102,7 +122,8 @@ public:
                         hostTokens.at(1),
                         tcpTarget.newUri));
 
-        AWAIT_TASK(tcpConnectTask, aioUring, tcpTarget.host, tcpTarget.port);
+        AWAIT_TASK(tcpConnectTask, aioUring, tcpTarget.host, tcpTarget.port,
+                   std::chrono::milliseconds{vsbconfig::MainConfiguration::instance().connectTimeoutMs});
 
         if(TASK_HAS_ERROR(tcpConnectTask)) {
 
@@ -119,17 +140,21 @@ public:
 
         targetSocket = TASK_RESULT_VALUE(tcpConnectTask);
 
-        AWAIT_TASKNL(tcpWrite, targetSocket, tcpBuffer.data(), tcpBuffer.size());
+        // the rewritten request line goes first, the rest of the request right from tcpBuffer
+        AWAIT_TASKNL(tcpWritev, targetSocket, std::vector<iovec>{
+                iovec{requestHead.data(), requestHead.size()},
+                iovec{tcpBuffer.data() + requestRestPos, tcpBuffer.size() - requestRestPos}});
 
-        if(TASK_HAS_ERROR(tcpWrite)) {
-            kklogging::ERROR(fmt::format("Socket write error: {}", TASK_ERROR_TEXT(tcpWrite)));
+        if(TASK_HAS_ERROR(tcpWritev)) {
+            kklogging::ERROR(fmt::format("Socket write error: {}", TASK_ERROR_TEXT(tcpWritev)));
         }
 
         tcpBuffer.clear();
 
         if(hostTokens.empty()) {
             // http protocol
-            AWAIT_TASK(tcpInterweaveTask, aioUring, clientSocket, targetSocket);
+            AWAIT_TASK(tcpInterweaveTask, aioUring, clientSocket, targetSocket,
+                       vsbconfig::MainConfiguration::instance().spliceRelay);
         } else {
             // rtsp protocol (rewrite uri)
             AWAIT_TASK(rtspInterweaveTask, aioUring, clientSocket, targetSocket,
@@ -148,7 +173,6 @@ public:
     }
 
     void replaceUri(std::string newUri) {
-        std::vector<char> newTcpBuffer{};
         std::vector<std::string> tokens{};
 
         utext::tokenizeByStr(requestHeader, tokens);
@@ -160,22 +184,9 @@ public:
 
         tokens[1] = std::move(newUri);
 
-        auto newRequestHeader = utext::join(tokens, " ");
-
-        newTcpBuffer.insert(newTcpBuffer.end(),
-                            std::make_move_iterator(newRequestHeader.begin()),
-                            std::make_move_iterator(newRequestHeader.end()));
-
-        auto xff = fmt::format("\r\nX-Forwarded-For: {}", inet_ntoa(client_addr.sin_addr));
-
-        newTcpBuffer.insert(newTcpBuffer.end(),
-                            std::make_move_iterator(xff.begin()),
-                            std::make_move_iterator(xff.end()));
-
-        newTcpBuffer.insert(newTcpBuffer.end(),
-                            std::make_move_iterator(newLineIter),
-                            std::make_move_iterator(tcpBuffer.end()));
-        tcpBuffer = std::move(newTcpBuffer);
+        requestHead = fmt::format("{}\r\nX-Forwarded-For: {}",
+                                  utext::join(tokens, " "), inet_ntoa(client_addr.sin_addr));
+        requestRestPos = newLinePos;
     }
 private:
     AIOUring *aioUring{nullptr};
@@ -185,13 +196,16 @@ private:
     TASK_DEF(TCPInterweaveTask, tcpInterweaveTask);
     TASK_DEF(RTSPInterweaveTask, rtspInterweaveTask);
     TASK_DEF(TCPShutAndClose, tcpShutAndClose);
-    TASK_DEF(TCPWrite, tcpWrite);
+    TASK_DEF(TCPWritev, tcpWritev);
     TASK_DEF(FindTargetTask, findTargetTask);
     TASK_DEF(SendBalancerResponse, sendBalancerResponse);
     int targetSocket{-1};
-    std::array<char, 4096> opBuffer{};
+    std::vector<char> opBuffer{};
     std::vector<char> tcpBuffer{};
     std::vector<char>::iterator newLineIter{};
+    // request line with the new uri, sent before tcpBuffer from requestRestPos
+    std::string requestHead{};
+    size_t requestRestPos{0};
     std::string_view tcpBufferView{};
     std::string_view::size_type newLinePos{};
     std::string requestHeader{};
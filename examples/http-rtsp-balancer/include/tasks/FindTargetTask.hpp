@@ -54,9 +54,14 @@ public:
             target = getMemUriTarget();
         } else if (redirect->type == "postgresql-uri") {
             if(redirect->postgresql.has_value()) {
-                AWAIT_LONG_TASK(postgresqlUri, [this](tf::Executor *executor) {
-                    setPostgresqlUriTarget();
+                AWAIT_LONG_TASK_RESULT_WITH(postgresqlUri, (AIOUringJobOptions{.category = "postgresql"}),
+                                            target, [this](tf::Executor *executor) {
+                    return getPostgresqlUriTarget();
                 });
+
+                if(io_result == -EBUSY) {
+                    kklogging::WARN(fmt::format("Postgresql lookup has been shed: {}", requestTokens[1]));
+                }
             } else {
                 kklogging::ERROR(fmt::format("No postgresql configuration for \"{}\" redirect.", redirect->name));
             }
@@ -75,10 +80,10 @@ public:
         })));
     }
 
-    void setPostgresqlUriTarget() {
+    std::optional<vsbtypes::BalancerTarget> getPostgresqlUriTarget() {
         if(redirect == nullptr) {
             kklogging::ERROR("redirect == nullptr");
-            return;
+            return std::nullopt;
         }
 
         auto uniqueKey = vsbutils::getUniqueUriParts(
@@ -86,9 +91,10 @@ public:
 
         if(!uniqueKey.has_value()) {
             kklogging::WARN(fmt::format("No unique key for {}", requestTokens[1]));
-            return;
+            return std::nullopt;
         }
 
+        std::optional<vsbtypes::BalancerTarget> pgTarget{std::nullopt};
         auto &pgConfig = *redirect->postgresql;
 
         try {
@@ -104,11 +110,11 @@ public:
                 wrk.commit();
 
                 if(!r.empty()) {
-                    setTargetFromHostString(r.front()["host"].c_str(), *uniqueKey, redirect->name);
+                    pgTarget = targetFromHostString(r.front()["host"].c_str());
                 }
             }
 
-            if(!target.has_value()) {
+            if(!pgTarget.has_value()) {
                 pqxx::work wrk{conn};
                 pqxx::result r{};
 
@@ -132,19 +138,19 @@ public:
                 wrk.commit();
 
                 if(!r.empty()) {
-                    setTargetFromHostString(r.front()["host"].c_str(), *uniqueKey, redirect->name);
+                    pgTarget = targetFromHostString(r.front()["host"].c_str());
                 }
             }
         } catch (pqxx::sql_error const &e) {
             kklogging::ERROR(fmt::format("SQL error: {}, Query was: {}", e.what(), e.query()));
         } catch(std::exception const &e) {
-            kklogging::ERROR(fmt::format("setPostgresqlUriTarget: {}", e.what()));
+            kklogging::ERROR(fmt::format("getPostgresqlUriTarget: {}", e.what()));
         }
+
+        return pgTarget;
     }
 
-    void setTargetFromHostString(const std::string& host,
-                                 const std::string& key,
-                                 const std::string& redirectName) {
+    static vsbtypes::BalancerTarget targetFromHostString(const std::string& host) {
 
         std::vector<std::string> tokens{};
 
@@ -154,17 +160,17 @@ public:
             throw std::runtime_error(fmt::format("No host tokens in {}.", host));
         }
 
-        auto balancerTarget = vsbtypes::BalancerTarget {
+        return vsbtypes::BalancerTarget {
                 .host = tokens[0],
                 .port = std::stoi(tokens[1])
         };
-
-        target = std::make_optional(balancerTarget);
     }
 
     std::optional<vsbtypes::BalancerTarget> getMemUriTarget() {
         static vsbtypes::KeyTargets keyTargets{};
         static uint32_t memIterator{0};
+        // shared between rings of the runtime
+        static std::mutex keyTargetsMutex{};
 
         if(redirect == nullptr) {
             kklogging::ERROR("redirect == nullptr");
@@ -175,6 +181,8 @@ public:
                 redirect->templates, urlTokens);
 
         if(uniqueKey.has_value()) {
+            std::lock_guard<std::mutex> lock{keyTargetsMutex};
+
             auto nameRedirectIter = keyTargets.find(redirect->name);
 
             if(nameRedirectIter == keyTargets.end()) {
@@ -19,14 +19,18 @@ public:
     TaskFuture poll(int io_result) override {
         ASYNC_IO;
 
-        aioUring->pushTask(aioUring->newTask<RTSPSinkTask<>>(
+        fromSink = pushSink(aioUring->newTask<RTSPSinkTask<>>(
                 aioUring, tcpFrom, tcpTo, rewriteHost,
-                targetName, client_addr, this->getTaskfd()));
-        aioUring->pushTask(aioUring->newTask<TCPSinkTask<>>(
-                aioUring, tcpTo, tcpFrom, this->getTaskfd()));
+                targetName, client_addr, aioUring->getTaskRef(this)));
+        toSink = pushSink(aioUring->newTask<TCPSinkTask<>>(
+                aioUring, tcpTo, tcpFrom, aioUring->getTaskRef(this)));
 
         //wait at least one task to make work done
-        AWAIT_EVENT(*this->getTaskfd().lock());
+        AWAIT_WAKE();
+
+        // tear down the other direction right away, the finished sink is already freed
+        aioUring->cancelTask(fromSink);
+        aioUring->cancelTask(toSink);
 
         return TASK_RESULT_NONE();
     }
@@ -37,6 +41,14 @@ private:
     std::vector<std::string> rewriteHost{};
     std::string targetName{};
     sockaddr_in client_addr{};
+    AIOUringTaskRef fromSink{};
+    AIOUringTaskRef toSink{};
+
+    template<typename T>
+    AIOUringTaskRef pushSink(T *sink) {
+        aioUring->pushTask(sink);
+        return aioUring->getTaskRef(sink);
+    }
 };
 
 #endif //HP_IO_URING_APPS_RTSPINTERWEAVETASK_HPP
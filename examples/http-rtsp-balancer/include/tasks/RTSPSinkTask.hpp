@@ -24,12 +24,12 @@ public:
                          std::vector<std::string> rewriteHost,
                          std::string targetName,
                          sockaddr_in client_addr,
-                         std::optional<std::weak_ptr<int>> notifyfd = std::nullopt)
+                         std::optional<AIOUringTaskRef> notifyTask = std::nullopt)
             : aioUring(aioUring), tcpFrom(tcpFrom), tcpTo(tcpTo),
                 rewriteHost(std::move(rewriteHost)),
                 targetName(std::move(targetName)),
                 client_addr(client_addr),
-                notifyfd(std::move(notifyfd)) {}
+                notifyTask(notifyTask) {}
 
     TaskFuture poll(int io_result) override {
         using namespace aioutils;
@@ -39,10 +39,20 @@ public:
         tcpBufferView = std::string_view{tcpBuffer.data(), tcpBuffer.size()};
 
         if(!uhttp::isContentReady(tcpBufferView)) {
-            AWAIT_OP(Read, readFrom, tcpFrom, buffer.data(), buffer.size());
+            if(aioUring->getReadBufferGroup() < 0) {
+                buffer.resize(BufferSize);
+            }
+
+            AWAIT_OP(ReadSelect, readFrom, tcpFrom, aioUring->getReadBufferGroup(),
+                     buffer.data(), buffer.size());
+
+            if(io_result == -ECANCELED) {
+                // the other direction is done
+                return TASK_RESULT_NONE();
+            }
 
             if(io_result < 0) {
-                return TASK_ERROR(fmt::format("Error on tcp read: {}", uexcept::errnoStr(-io_result)));
+                return TASK_ERROR("Error on tcp read: {}", strerror(-io_result));
             }
 
             if(io_result == 0) {
@@ -50,7 +60,12 @@ public:
                 return TASK_RESULT_NONE();
             }
 
-            tcpBuffer.insert(tcpBuffer.end(), buffer.begin(), buffer.begin() + io_result);
+            {
+                AIOUringBuffer chunk = aioUring->takeBuffer(io_result);
+                const char *data = chunk ? chunk.data() : buffer.data();
+
+                tcpBuffer.insert(tcpBuffer.end(), data, data + io_result);
+            }
 
             AWAIT_POLL();
         }
@@ -62,17 +77,43 @@ public:
 
         bytesToWrite = tcpBuffer.size();
         offset = 0;
+        sentZeroCopy = false;
+
+        ASYNC_LOOP(writeContent);
 
-        AWAIT_OP(Write, writeTo, tcpTo, tcpBuffer.data() + offset, bytesToWrite);
+        zeroCopy = aioUring->getZeroCopyThreshold() > 0 &&
+                   static_cast<size_t>(bytesToWrite) >= aioUring->getZeroCopyThreshold();
+
+        if(zeroCopy) {
+            AWAIT_OP(SendZC, sendTo, tcpTo, tcpBuffer.data() + offset, bytesToWrite);
+        } else {
+            AWAIT_OP(Write, writeTo, tcpTo, tcpBuffer.data() + offset, bytesToWrite);
+        }
+
+        if(io_result == -ECANCELED) {
+            // the other direction is done
+            return TASK_RESULT_NONE();
+        }
 
         if(io_result < 0) {
-            return TASK_ERROR(fmt::format("Error on tcp write: {}", uexcept::errnoStr(-io_result)));
+            return TASK_ERROR("Error on tcp write: {}", strerror(-io_result));
         }
 
+        sentZeroCopy = sentZeroCopy || zeroCopy;
+
         if(io_result < bytesToWrite) {
             bytesToWrite -= io_result;
             offset += io_result;
-            ASYNC_CONTINUE_OP(writeTo);
+            AWAIT_LOOP(writeContent);
+        }
+
+        if(sentZeroCopy) {
+            // tcpBuffer is refilled only after the kernel has released it
+            AWAIT_OP(ZeroCopyFlush, flushSends);
+
+            if(io_result == -ECANCELED) {
+                return TASK_RESULT_NONE();
+            }
         }
 
         tcpBuffer.clear();
@@ -168,10 +209,8 @@ public:
     }
 
     TaskFuture finally(int io_result) override {
-        if(notifyfd.has_value()) {
-            if(auto eventFd = notifyfd->lock()) {
-                EVENT_NOTIFY(*eventFd);
-            }
+        if(notifyTask.has_value()) {
+            aioUring->wake(*notifyTask);
         }
         return TASK_RESULT_NONE();
     }
@@ -182,11 +221,14 @@ private:
     std::vector<std::string> rewriteHost{};
     std::string targetName{};
     sockaddr_in client_addr{};
-    std::optional<std::weak_ptr<int>> notifyfd{};
-    std::array<char, BufferSize> buffer{};
+    std::optional<AIOUringTaskRef> notifyTask{};
+    // allocated only without provided buffers
+    std::vector<char> buffer{};
     std::vector<char> tcpBuffer{};
     int bytesToWrite{};
     int offset{};
+    bool zeroCopy{false};
+    bool sentZeroCopy{false};
     std::string_view tcpBufferView{};
 };
 
@@ -41,11 +41,16 @@ public:
         tcpBufferView = std::string_view{tcpBuffer.data(), tcpBuffer.size()};
 
         if(!uhttp::isContentReady(tcpBufferView)) {
-            AWAIT_OP(Read, readClient, clientSocket, opBuffer.data(), opBuffer.size());
+            if(aioUring->getReadBufferGroup() < 0) {
+                opBuffer.resize(4096);
+            }
+
+            AWAIT_OP(ReadSelect, readClient, clientSocket, aioUring->getReadBufferGroup(),
+                     opBuffer.data(), opBuffer.size());
 
             if(io_result < 0)
             {
-                return TASK_ERROR(fmt::format("Failed to read TCP: {}", std::string(strerror(-io_result))));
+                return TASK_ERROR("Failed to read TCP: {}", strerror(-io_result));
             }
 
             if(io_result == 0)
@@ -54,7 +59,12 @@ public:
                 return TASK_RESULT_NONE();
             }
 
-            tcpBuffer.insert(tcpBuffer.end(), opBuffer.begin(), opBuffer.begin() + io_result);
+            {
+                AIOUringBuffer chunk = aioUring->takeBuffer(io_result);
+                const char *data = chunk ? chunk.data() : opBuffer.data();
+
+                tcpBuffer.insert(tcpBuffer.end(), data, data + io_result);
+            }
 
             AWAIT_POLL();
         }
@@ -67,9 +77,16 @@ public:
             AWAIT_TASKNL(httpJsonResponseTask, aioUring, clientSocket, resultJson.dump());
         } else if(urlTokens.at(0) == "records" && urlTokens.size() == 3 &&
             httpRequest.getMethod() == uhttp::HttpRequestMethod::DELETE) {
-            AWAIT_LONG_TASK(postgresqlUri, [this](tf::Executor *executor) {
+            AWAIT_LONG_TASK_WITH(postgresqlUri, (AIOUringJobOptions{
+                    .category = "postgresql",
+                    .priority = AIOUringJobPriority::Low
+            }), [this](tf::Executor *executor) {
                 removeRecord(urlTokens.at(1), urlTokens.at(2));
             });
+
+            if(io_result == -EBUSY) {
+                kklogging::WARN(fmt::format("Removal of {} has been shed", urlTokens.at(2)));
+            }
             AWAIT_TASKNL(http200ResponseTask, aioUring, clientSocket);
         } else {
             AWAIT_TASKNL(http404ResponseTask, aioUring, clientSocket);
@@ -117,7 +134,7 @@ private:
     std::vector<char> tcpBuffer{};
     int clientSocket{-1};
     std::string_view tcpBufferView{};
-    std::array<char, 4096> opBuffer{};
+    std::vector<char> opBuffer{};
     std::vector<vsbtypes::BalancerRedirectsConfig> redirects{};
     nlohmann::json resultJson;
     uhttp::HttpRequest httpRequest{};
@@ -23,6 +23,17 @@ namespace vsbconfig {
     struct MainConfiguration {
         int port{1558};
         int maxBacklog{128};
+        int threads{0};
+        int connectTimeoutMs{5000};
+        int clientReadTimeoutMs{30000};
+        int zeroCopyThreshold{16384};
+        bool spliceRelay{false};
+        int sqEntries{4096};
+        int cqEntries{0};
+        int blockingThreads{0};
+        int blockingMaxQueued{4096};
+        int postgresqlMaxInFlight{16};
+        bool balanceRings{true};
         std::vector<vsbtypes::BalancerRedirectsConfig> redirects{};
         std::vector<vsbtypes::PostgresqlConn> postgresql{};
         vsbtypes::RedirectsMap map{};
@@ -73,8 +84,65 @@ namespace vsbconfig {
 
         config = jsonConfig.get<MainConfiguration>();
 
+        if(jsonConfig.contains("threads")) {
+            config.threads = jsonConfig["threads"].get<int>();
+        }
+
+        if(jsonConfig.contains("connectTimeoutMs")) {
+            config.connectTimeoutMs = jsonConfig["connectTimeoutMs"].get<int>();
+        }
+
+        if(jsonConfig.contains("clientReadTimeoutMs")) {
+            config.clientReadTimeoutMs = jsonConfig["clientReadTimeoutMs"].get<int>();
+        }
+
+        if(jsonConfig.contains("zeroCopyThreshold")) {
+            config.zeroCopyThreshold = jsonConfig["zeroCopyThreshold"].get<int>();
+        }
+
+        if(jsonConfig.contains("spliceRelay")) {
+            config.spliceRelay = jsonConfig["spliceRelay"].get<bool>();
+        }
+
+        if(jsonConfig.contains("sqEntries")) {
+            config.sqEntries = jsonConfig["sqEntries"].get<int>();
+        }
+
+        if(jsonConfig.contains("cqEntries")) {
+            config.cqEntries = jsonConfig["cqEntries"].get<int>();
+        }
+
+        if(jsonConfig.contains("blockingThreads")) {
+            config.blockingThreads = jsonConfig["blockingThreads"].get<int>();
+        }
+
+        if(jsonConfig.contains("blockingMaxQueued")) {
+            config.blockingMaxQueued = jsonConfig["blockingMaxQueued"].get<int>();
+        }
+
+        if(jsonConfig.contains("postgresqlMaxInFlight")) {
+            config.postgresqlMaxInFlight = jsonConfig["postgresqlMaxInFlight"].get<int>();
+        }
+
+        if(jsonConfig.contains("balanceRings")) {
+            config.balanceRings = jsonConfig["balanceRings"].get<bool>();
+        }
+
         rewriteWithEnvironment(config);
 
+        if(config.zeroCopyThreshold < 0) {
+            throw std::runtime_error("zeroCopyThreshold must be >= 0");
+        }
+
+        if(config.sqEntries <= 0 || config.cqEntries < 0) {
+            throw std::runtime_error("sqEntries must be > 0, cqEntries must be >= 0");
+        }
+
+        if(config.blockingThreads < 0 || config.blockingMaxQueued <= 0 || config.postgresqlMaxInFlight < 0) {
+            throw std::runtime_error("blockingThreads and postgresqlMaxInFlight must be >= 0, "
+                                     "blockingMaxQueued must be > 0");
+        }
+
         for(auto &r : config.redirects) {
             if(r.name.empty()) {
                 throw std::runtime_error("redirect name is empty");
@@ -97,6 +165,22 @@ namespace vsbconfig {
     static void rewriteWithEnvironment(MainConfiguration &config) {
         uenv::setVariableFromEnvironment(fmt::format("{}_PORT", envPrefix), config.port, true);
         uenv::setVariableFromEnvironment(fmt::format("{}_MAX_BACKLOG", envPrefix), config.maxBacklog, true);
+        uenv::setVariableFromEnvironment(fmt::format("{}_THREADS", envPrefix), config.threads, false);
+        uenv::setVariableFromEnvironment(fmt::format("{}_CONNECT_TIMEOUT_MS", envPrefix),
+                                         config.connectTimeoutMs, false);
+        uenv::setVariableFromEnvironment(fmt::format("{}_CLIENT_READ_TIMEOUT_MS", envPrefix),
+                                         config.clientReadTimeoutMs, false);
+        uenv::setVariableFromEnvironment(fmt::format("{}_ZERO_COPY_THRESHOLD", envPrefix),
+                                         config.zeroCopyThreshold, false);
+        uenv::setVariableFromEnvironment(fmt::format("{}_SPLICE_RELAY", envPrefix), config.spliceRelay);
+        uenv::setVariableFromEnvironment(fmt::format("{}_SQ_ENTRIES", envPrefix), config.sqEntries, true);
+        uenv::setVariableFromEnvironment(fmt::format("{}_CQ_ENTRIES", envPrefix), config.cqEntries, false);
+        uenv::setVariableFromEnvironment(fmt::format("{}_BLOCKING_THREADS", envPrefix), config.blockingThreads, false);
+        uenv::setVariableFromEnvironment(fmt::format("{}_BLOCKING_MAX_QUEUED", envPrefix),
+                                         config.blockingMaxQueued, true);
+        uenv::setVariableFromEnvironment(fmt::format("{}_POSTGRESQL_MAX_IN_FLIGHT", envPrefix),
+                                         config.postgresqlMaxInFlight, false);
+        uenv::setVariableFromEnvironment(fmt::format("{}_BALANCE_RINGS", envPrefix), config.balanceRings);
 
         for(auto &r : config.redirects) {
             std::string targetsStr{};
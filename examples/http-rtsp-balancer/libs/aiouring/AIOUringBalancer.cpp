@@ -0,0 +1,194 @@
+#include "include/aiouring/AIOUringBalancer.h"
+#include "include/aiouring/AIOUring.h"
+
+#include <algorithm>
+
+bool AIOUringLoadMeter::sample(Clock::time_point now, Clock::duration interval) {
+    auto elapsed = now - sampledAt;
+
+    if(elapsed < interval || elapsed <= Clock::duration::zero())
+    {
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    auto busy = std::max(elapsed - idle, Clock::duration::zero());
+
+    bytesPerSec.store(static_cast<uint64_t>(static_cast<double>(bytes) / seconds), std::memory_order_relaxed);
+    cqesPerSec.store(static_cast<uint64_t>(static_cast<double>(cqes) / seconds), std::memory_order_relaxed);
+    tasksNow.store(tasks, std::memory_order_relaxed);
+    busyPermille.store(static_cast<uint32_t>(busy * 1000 / elapsed), std::memory_order_relaxed);
+    // the connections steered so far show up in the rates from now on
+    steeredIn.store(0, std::memory_order_relaxed);
+
+    bytes = 0;
+    cqes = 0;
+    idle = Clock::duration::zero();
+    sampledAt = now;
+
+    return true;
+}
+
+AIOUringLoadMeter::Clock::time_point AIOUringLoadMeter::nextSample(Clock::duration interval) const {
+    return sampledAt + interval;
+}
+
+AIOUringLoad AIOUringLoadMeter::load() const {
+    return AIOUringLoad {
+            .bytesPerSec = bytesPerSec.load(std::memory_order_relaxed),
+            .cqesPerSec = cqesPerSec.load(std::memory_order_relaxed),
+            .tasks = tasksNow.load(std::memory_order_relaxed),
+            .busyPermille = busyPermille.load(std::memory_order_relaxed),
+            .steeredIn = steeredIn.load(std::memory_order_relaxed),
+            .offered = offered.load(std::memory_order_relaxed)
+    };
+}
+
+AIOUringBalancer::AIOUringBalancer(size_t ringsNumber, AIOUringBalanceOptions options) :
+        ringsNumber{ringsNumber}, options{options},
+        rings{std::make_unique<std::atomic<AIOUring *>[]>(ringsNumber)} {
+
+}
+
+void AIOUringBalancer::attach(size_t index, AIOUring *aioUring) {
+    aioUring->balancer = this;
+    rings[index].store(aioUring, std::memory_order_release);
+}
+
+void AIOUringBalancer::detach(size_t index) {
+    AIOUring *aioUring = rings[index].exchange(nullptr, std::memory_order_acq_rel);
+
+    if(aioUring != nullptr)
+    {
+        aioUring->balancer = nullptr;
+    }
+}
+
+const AIOUringBalanceOptions &AIOUringBalancer::getOptions() const {
+    return options;
+}
+
+AIOUring *AIOUringBalancer::steerTarget(AIOUring *from) {
+    if(!options.steerAccepts)
+    {
+        return nullptr;
+    }
+
+    AIOUringLoad own = from->getLoad();
+
+    if(own.bytesPerSec < options.minBytesPerSec)
+    {
+        return nullptr;
+    }
+
+    // connections steered since the last sample of a ring aren't in its rates yet,
+    // each of them counts as an average connection of the hot ring
+    double perConnection = own.tasks > 0 ? static_cast<double>(own.bytesPerSec) / static_cast<double>(own.tasks) : 0;
+    double targetScore = static_cast<double>(own.bytesPerSec) / options.hotRatio;
+    AIOUring *target{nullptr};
+
+    for(size_t index = 0; index < ringsNumber; ++index)
+    {
+        AIOUring *aioUring = rings[index].load(std::memory_order_acquire);
+
+        if(aioUring == nullptr || aioUring == from)
+        {
+            continue;
+        }
+
+        AIOUringLoad load = aioUring->getLoad();
+        double score = static_cast<double>(load.bytesPerSec) + load.steeredIn * perConnection;
+
+        if(score < targetScore)
+        {
+            target = aioUring;
+            targetScore = score;
+        }
+    }
+
+    if(target != nullptr)
+    {
+        target->loadMeter.noteSteeredIn();
+    }
+
+    return target;
+}
+
+AIOUring *AIOUringBalancer::stealVictim(AIOUring *thief) {
+    if(!options.stealWork)
+    {
+        return nullptr;
+    }
+
+    AIOUring *victim{nullptr};
+    size_t victimOffered{0};
+
+    for(size_t index = 0; index < ringsNumber; ++index)
+    {
+        AIOUring *aioUring = rings[index].load(std::memory_order_acquire);
+
+        if(aioUring == nullptr || aioUring == thief)
+        {
+            continue;
+        }
+
+        size_t offered = aioUring->getLoad().offered;
+
+        if(offered > victimOffered)
+        {
+            victim = aioUring;
+            victimOffered = offered;
+        }
+    }
+
+    return victim;
+}
+
+void AIOUringBalancer::wakeThief(AIOUring *from) {
+    if(!options.stealWork)
+    {
+        return;
+    }
+
+    AIOUring *thief{nullptr};
+    uint32_t thiefBusy{1000};
+
+    for(size_t index = 0; index < ringsNumber; ++index)
+    {
+        AIOUring *aioUring = rings[index].load(std::memory_order_acquire);
+
+        if(aioUring == nullptr || aioUring == from)
+        {
+            continue;
+        }
+
+        AIOUringLoad load = aioUring->getLoad();
+
+        if(load.offered == 0 && load.busyPermille < thiefBusy)
+        {
+            thief = aioUring;
+            thiefBusy = load.busyPermille;
+        }
+    }
+
+    if(thief != nullptr)
+    {
+        thief->nudge();
+    }
+}
+
+std::vector<AIOUringLoad> AIOUringBalancer::getLoads() const {
+    std::vector<AIOUringLoad> loads(ringsNumber);
+
+    for(size_t index = 0; index < ringsNumber; ++index)
+    {
+        AIOUring *aioUring = rings[index].load(std::memory_order_acquire);
+
+        if(aioUring != nullptr)
+        {
+            loads[index] = aioUring->getLoad();
+        }
+    }
+
+    return loads;
+}
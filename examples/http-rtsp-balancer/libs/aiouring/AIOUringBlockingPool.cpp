@@ -0,0 +1,266 @@
+#include "include/aiouring/AIOUringBlockingPool.h"
+
+#include <algorithm>
+#include <iterator>
+#include <fmt/core.h>
+#include <kklogging/kklogging.h>
+#include <thread>
+
+AIOUringBlockingPool::AIOUringBlockingPool(AIOUringBlockingPoolOptions options) :
+        threads{options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency())},
+        maxQueued{options.maxQueued}, executor{threads} {
+
+}
+
+AIOUringBlockingPool::~AIOUringBlockingPool() {
+    std::vector<QueuedJob> shedJobs{};
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        stopping = true;
+
+        for(auto &[name, category] : categories)
+        {
+            for(auto &queue : category.queued)
+            {
+                std::move(queue.begin(), queue.end(), std::back_inserter(shedJobs));
+                queue.clear();
+            }
+        }
+    }
+
+    for(auto &queuedJob : shedJobs)
+    {
+        if(queuedJob.job.shed)
+        {
+            queuedJob.job.shed();
+        }
+    }
+
+    executor.wait_for_all();
+}
+
+AIOUringBlockingPool &AIOUringBlockingPool::shared() {
+    std::lock_guard<std::mutex> lock{sharedMutex};
+
+    if(sharedPool == nullptr)
+    {
+        sharedPool = std::make_unique<AIOUringBlockingPool>(sharedOptions);
+    }
+
+    return *sharedPool;
+}
+
+void AIOUringBlockingPool::configureShared(AIOUringBlockingPoolOptions options) {
+    std::lock_guard<std::mutex> lock{sharedMutex};
+
+    if(sharedPool != nullptr)
+    {
+        kklogging::WARN("The shared blocking pool is already running, its options stay unchanged.");
+        return;
+    }
+
+    sharedOptions = options;
+}
+
+void AIOUringBlockingPool::setCategory(const std::string &category, AIOUringBlockingCategoryLimits limits) {
+    std::lock_guard<std::mutex> lock{mutex};
+
+    categories[category].limits = limits;
+
+    // a raised limit may let queued jobs start
+    dispatch();
+}
+
+bool AIOUringBlockingPool::submit(AIOUringBlockingJob job) {
+    std::vector<QueuedJob> shedJobs{};
+    bool accepted{false};
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        Category &category = categories[job.options.category];
+        auto priority = job.options.priority;
+
+        ++category.submitted;
+
+        if(!stopping)
+        {
+            bool categoryFull = category.queuedCount >= queuedLimit(category);
+
+            accepted = (!categoryFull && queued < maxQueued) ||
+                       shedLowerThan(priority, categoryFull ? &category : nullptr, shedJobs);
+        }
+
+        if(accepted)
+        {
+            category.queued[static_cast<size_t>(priority)].push_back(QueuedJob{
+                    .job = std::move(job),
+                    .submittedAt = Clock::now()
+            });
+            ++queued;
+            category.queuedHighWater = std::max(category.queuedHighWater, ++category.queuedCount);
+
+            dispatch();
+        }
+        else
+        {
+            ++category.shed;
+            ++shed;
+        }
+    }
+
+    for(auto &queuedJob : shedJobs)
+    {
+        if(queuedJob.job.shed)
+        {
+            queuedJob.job.shed();
+        }
+    }
+
+    if(!accepted && job.shed)
+    {
+        job.shed();
+    }
+
+    return accepted;
+}
+
+size_t AIOUringBlockingPool::getThreadsNumber() const {
+    return threads;
+}
+
+AIOUringBlockingPoolStats AIOUringBlockingPool::getStats() const {
+    std::lock_guard<std::mutex> lock{mutex};
+
+    AIOUringBlockingPoolStats stats {
+            .threads = threads,
+            .running = running,
+            .queued = queued,
+            .maxQueued = maxQueued,
+            .shed = shed
+    };
+
+    for(auto &[name, category] : categories)
+    {
+        uint64_t started = category.completed + category.inFlight;
+
+        stats.categories.push_back(AIOUringBlockingCategoryStats {
+                .category = name,
+                .limits = category.limits,
+                .inFlight = category.inFlight,
+                .queued = category.queuedCount,
+                .queuedHighWater = category.queuedHighWater,
+                .submitted = category.submitted,
+                .completed = category.completed,
+                .shed = category.shed,
+                .waitAvgNs = started > 0 ? category.waitSumNs / started : 0,
+                .waitMaxNs = category.waitMaxNs
+        });
+    }
+
+    return stats;
+}
+
+size_t AIOUringBlockingPool::inFlightLimit(const Category &category) const {
+    return category.limits.maxInFlight > 0 ? std::min(category.limits.maxInFlight, threads) : threads;
+}
+
+size_t AIOUringBlockingPool::queuedLimit(const Category &category) const {
+    return category.limits.maxQueued > 0 ? std::min(category.limits.maxQueued, maxQueued) : maxQueued;
+}
+
+bool AIOUringBlockingPool::shedLowerThan(AIOUringJobPriority priority, Category *category,
+                                         std::vector<QueuedJob> &shedJobs) {
+    // the newest job of the lowest priority goes first
+    for(auto level = static_cast<size_t>(AIOUringJobPriority::Low); level > static_cast<size_t>(priority); --level)
+    {
+        for(auto &[name, candidate] : categories)
+        {
+            if(category != nullptr && category != &candidate)
+            {
+                continue;
+            }
+
+            auto &queue = candidate.queued[level];
+
+            if(queue.empty())
+            {
+                continue;
+            }
+
+            shedJobs.push_back(std::move(queue.back()));
+            queue.pop_back();
+            --candidate.queuedCount;
+            --queued;
+            ++candidate.shed;
+            ++shed;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void AIOUringBlockingPool::dispatch() {
+    while(running < threads && !stopping)
+    {
+        bool started{false};
+
+        for(size_t level = 0; level < std::tuple_size_v<decltype(Category::queued)> && !started; ++level)
+        {
+            for(auto &[name, category] : categories)
+            {
+                if(!category.queued[level].empty() && category.inFlight < inFlightLimit(category))
+                {
+                    start(category, category.queued[level]);
+                    started = true;
+                    break;
+                }
+            }
+        }
+
+        if(!started)
+        {
+            return;
+        }
+    }
+}
+
+void AIOUringBlockingPool::start(Category &category, std::deque<QueuedJob> &queue) {
+    QueuedJob queuedJob = std::move(queue.front());
+
+    queue.pop_front();
+    --category.queuedCount;
+    --queued;
+    ++category.inFlight;
+    ++running;
+
+    auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - queuedJob.submittedAt);
+
+    category.waitSumNs += static_cast<uint64_t>(wait.count());
+    category.waitMaxNs = std::max(category.waitMaxNs, static_cast<uint64_t>(wait.count()));
+
+    // map nodes are never erased, the category outlives the job
+    executor.silent_async([this, categoryPtr = &category, run = std::move(queuedJob.job.run)]() {
+        try {
+            run(&executor);
+        } catch (std::exception &e) {
+            kklogging::ERROR(fmt::format("During blocking job: {}", e.what()));
+        }
+
+        finish(categoryPtr);
+    });
+}
+
+void AIOUringBlockingPool::finish(Category *category) {
+    std::lock_guard<std::mutex> lock{mutex};
+
+    --category->inFlight;
+    --running;
+    ++category->completed;
+
+    dispatch();
+}
@@ -0,0 +1,142 @@
+#include "include/aiouring/AIOUringBufferRing.h"
+#include "include/aiouring/AIOUring.h"
+
+#include <algorithm>
+#include <bit>
+
+AIOUringBuffer::AIOUringBuffer(AIOUringBufferRing *bufferRing, uint16_t bufferId, size_t length) :
+        bufferRing{bufferRing}, bufferId{bufferId}, length{length} {
+
+}
+
+AIOUringBuffer::AIOUringBuffer(AIOUringBuffer &&other) noexcept :
+        bufferRing{std::exchange(other.bufferRing, nullptr)}, bufferId{other.bufferId}, length{other.length} {
+
+}
+
+AIOUringBuffer &AIOUringBuffer::operator=(AIOUringBuffer &&other) noexcept {
+    if(this != &other)
+    {
+        release();
+        bufferRing = std::exchange(other.bufferRing, nullptr);
+        bufferId = other.bufferId;
+        length = other.length;
+    }
+
+    return *this;
+}
+
+AIOUringBuffer::~AIOUringBuffer() {
+    release();
+}
+
+char *AIOUringBuffer::data() const {
+    return bufferRing != nullptr ? bufferRing->bufferData(bufferId) : nullptr;
+}
+
+size_t AIOUringBuffer::size() const {
+    return bufferRing != nullptr ? length : 0;
+}
+
+std::string_view AIOUringBuffer::view() const {
+    return std::string_view{data(), size()};
+}
+
+void AIOUringBuffer::release() {
+    if(bufferRing != nullptr)
+    {
+        std::exchange(bufferRing, nullptr)->recycle(bufferId);
+    }
+}
+
+AIOUringBufferRing::AIOUringBufferRing(io_uring *ring, uint16_t groupId, unsigned buffers, size_t bufferSize) :
+        ring{ring}, groupId{groupId}, buffers{buffers}, bufferSize{bufferSize} {
+    if(buffers == 0 || buffers > 32768 || !std::has_single_bit(buffers))
+    {
+        throw AIOUringException(fmt::format("Buffer group {}: number of buffers must be a power of 2 "
+                                            "up to 32768, got {}.", groupId, buffers));
+    }
+
+    int result = 0;
+
+    bufRing = io_uring_setup_buf_ring(ring, buffers, groupId, 0, &result);
+
+    if(bufRing == nullptr)
+    {
+        throw AIOUringException(fmt::format("Buffer group {}: io_uring_setup_buf_ring failed: {}",
+                                            groupId, aioutils::uexcept::errnoStr(-result)));
+    }
+
+    memory = std::make_unique<char[]>(buffers * bufferSize);
+    takenAt.resize(buffers);
+
+    for(unsigned bufferId = 0; bufferId < buffers; ++bufferId)
+    {
+        io_uring_buf_ring_add(bufRing, bufferData(bufferId), static_cast<unsigned>(bufferSize),
+                              static_cast<unsigned short>(bufferId), io_uring_buf_ring_mask(buffers),
+                              static_cast<int>(bufferId));
+    }
+
+    io_uring_buf_ring_advance(bufRing, static_cast<int>(buffers));
+}
+
+AIOUringBufferRing::~AIOUringBufferRing() {
+    if(bufRing != nullptr)
+    {
+        io_uring_free_buf_ring(ring, bufRing, buffers, groupId);
+    }
+}
+
+void AIOUringBufferRing::hold(uint16_t bufferId) {
+    takenAt[bufferId] = Clock::now();
+    ++taken;
+    highWater = std::max(highWater, ++inUse);
+}
+
+AIOUringBuffer AIOUringBufferRing::take(uint16_t bufferId, size_t length) {
+    return AIOUringBuffer{this, bufferId, length};
+}
+
+void AIOUringBufferRing::recycle(uint16_t bufferId) {
+    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - takenAt[bufferId]);
+    auto latencyNs = static_cast<uint64_t>(latency.count());
+
+    ++recycled;
+    recycleLatencySumNs += latencyNs;
+    recycleLatencyMaxNs = std::max(recycleLatencyMaxNs, latencyNs);
+    --inUse;
+
+    io_uring_buf_ring_add(bufRing, bufferData(bufferId), static_cast<unsigned>(bufferSize),
+                          bufferId, io_uring_buf_ring_mask(buffers), 0);
+    io_uring_buf_ring_advance(bufRing, 1);
+}
+
+void AIOUringBufferRing::noteExhausted() {
+    ++exhausted;
+}
+
+char *AIOUringBufferRing::bufferData(uint16_t bufferId) const {
+    return memory.get() + static_cast<size_t>(bufferId) * bufferSize;
+}
+
+uint16_t AIOUringBufferRing::getGroupId() const {
+    return groupId;
+}
+
+size_t AIOUringBufferRing::available() const {
+    return buffers - inUse;
+}
+
+AIOUringBufferGroupStats AIOUringBufferRing::getStats() const {
+    return AIOUringBufferGroupStats {
+            .groupId = groupId,
+            .bufferSize = bufferSize,
+            .buffers = buffers,
+            .inUse = inUse,
+            .highWater = highWater,
+            .taken = taken,
+            .exhausted = exhausted,
+            .recycleLatencyAvgNs = recycled > 0 ? recycleLatencySumNs / recycled : 0,
+            .recycleLatencyMaxNs = recycleLatencyMaxNs
+    };
+}
@@ -0,0 +1,75 @@
+#include "include/aiouring/AIOUringFrameAllocator.h"
+
+AIOUringFrameAllocator::~AIOUringFrameAllocator() {
+    if(current == this)
+    {
+        current = nullptr;
+    }
+}
+
+void *AIOUringFrameAllocator::allocate(size_t size) {
+    const size_t blockSize = sizeof(FrameHeader) + size;
+    FrameHeader *header;
+
+    if(current != nullptr && blockSize <= maxPooledSize)
+    {
+        AIOUringTaskPool &pool = current->getPool(blockSize);
+        header = static_cast<FrameHeader *>(pool.acquire());
+        header->pool = &pool;
+    }
+    else
+    {
+        header = static_cast<FrameHeader *>(::operator new(blockSize));
+        header->pool = nullptr;
+    }
+
+    return header + 1;
+}
+
+void AIOUringFrameAllocator::deallocate(void *frame) noexcept {
+    FrameHeader *header = static_cast<FrameHeader *>(frame) - 1;
+
+    if(header->pool != nullptr)
+    {
+        header->pool->release(header);
+    }
+    else
+    {
+        ::operator delete(header);
+    }
+}
+
+void AIOUringFrameAllocator::setCurrent(AIOUringFrameAllocator *allocator) {
+    current = allocator;
+}
+
+std::vector<AIOUringTaskPoolStats> AIOUringFrameAllocator::getStats() const {
+    std::vector<AIOUringTaskPoolStats> stats{};
+
+    for(auto &pool : pools)
+    {
+        if(pool != nullptr)
+        {
+            stats.push_back(pool->getStats());
+        }
+    }
+
+    return stats;
+}
+
+AIOUringTaskPool &AIOUringFrameAllocator::getPool(size_t size) {
+    const size_t index = (size + sizeClass - 1) / sizeClass - 1;
+
+    if(index >= pools.size())
+    {
+        pools.resize(index + 1);
+    }
+
+    if(pools[index] == nullptr)
+    {
+        pools[index] = std::make_unique<AIOUringTaskPool>(
+                index, "coroutine frame", (index + 1) * sizeClass, alignof(FrameHeader));
+    }
+
+    return *pools[index];
+}
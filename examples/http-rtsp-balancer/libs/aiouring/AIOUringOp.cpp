@@ -1,78 +1,411 @@
 #include "include/aiouring/AIOUringOp.h"
 
+#include <algorithm>
+
+void AIOUringOp::prepareSqe(io_uring_sqe *sqe) const {
+    switch(kind) {
+        case Kind::Nop:
+            io_uring_prep_nop(sqe);
+            break;
+        case Kind::Read:
+            io_uring_prep_read(sqe, fd, addr, len, offset);
+            break;
+        case Kind::Write:
+            io_uring_prep_write(sqe, fd, addr, len, offset);
+            break;
+        case Kind::ReadFixed:
+            io_uring_prep_read_fixed(sqe, fd, addr, len, offset, static_cast<int>(bufferIndex));
+            break;
+        case Kind::WriteFixed:
+            io_uring_prep_write_fixed(sqe, fd, addr, len, offset, static_cast<int>(bufferIndex));
+            break;
+        case Kind::Readv:
+            io_uring_prep_readv(sqe, fd, static_cast<const iovec *>(addr), len, offset);
+            break;
+        case Kind::Writev:
+            io_uring_prep_writev(sqe, fd, static_cast<const iovec *>(addr), len, offset);
+            break;
+        case Kind::Recv:
+            io_uring_prep_recv(sqe, fd, addr, len, flags);
+            break;
+        case Kind::SendMsg:
+            io_uring_prep_sendmsg(sqe, fd, static_cast<const msghdr *>(addr), static_cast<unsigned>(flags));
+            break;
+        case Kind::RecvMsg:
+            io_uring_prep_recvmsg(sqe, fd, static_cast<msghdr *>(addr), static_cast<unsigned>(flags));
+            break;
+        case Kind::RecvMultishot:
+            io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, flags);
+            break;
+        case Kind::SendZC:
+            io_uring_prep_send_zc(sqe, fd, addr, len, flags, 0);
+            break;
+        case Kind::SendZCFixed:
+            io_uring_prep_send_zc_fixed(sqe, fd, addr, len, flags, 0, bufferIndex);
+            break;
+        case Kind::Splice: {
+            int fdIn = static_cast<int>(offset);
+            unsigned spliceFlags = static_cast<unsigned>(flags);
+
+            if(isDirectFd(fdIn)) {
+                fdIn = static_cast<int>(directIndex(fdIn));
+                spliceFlags |= SPLICE_F_FD_IN_FIXED;
+            }
+
+            io_uring_prep_splice(sqe, fdIn, -1, fd, -1, len, spliceFlags);
+            break;
+        }
+        case Kind::Poll:
+            io_uring_prep_poll_add(sqe, fd, len);
+            break;
+        case Kind::Accept:
+            if(len == IORING_FILE_INDEX_ALLOC) {
+                io_uring_prep_accept_direct(sqe, fd, static_cast<sockaddr *>(addr),
+                                            static_cast<socklen_t *>(addr2), flags, IORING_FILE_INDEX_ALLOC);
+            } else {
+                io_uring_prep_accept(sqe, fd, static_cast<sockaddr *>(addr),
+                                     static_cast<socklen_t *>(addr2), flags);
+            }
+            break;
+        case Kind::AcceptMultishot:
+            if(len == IORING_FILE_INDEX_ALLOC) {
+                io_uring_prep_multishot_accept_direct(sqe, fd, nullptr, nullptr, flags);
+            } else {
+                io_uring_prep_multishot_accept(sqe, fd, nullptr, nullptr, flags);
+            }
+            break;
+        case Kind::Close:
+            if(isDirectFd(fd)) {
+                io_uring_prep_close_direct(sqe, directIndex(fd));
+            } else {
+                io_uring_prep_close(sqe, fd);
+            }
+            break;
+        case Kind::Connect:
+            io_uring_prep_connect(sqe, fd, static_cast<const sockaddr *>(addr), len);
+            break;
+        case Kind::Shutdown:
+            io_uring_prep_shutdown(sqe, fd, static_cast<int>(len));
+            break;
+        case Kind::Timeout:
+            io_uring_prep_timeout(sqe, static_cast<__kernel_timespec *>(addr), 0, 0);
+            break;
+        case Kind::InstallFile:
+            io_uring_prep_files_update(sqe, static_cast<int *>(addr), 1, static_cast<int>(IORING_FILE_INDEX_ALLOC));
+            break;
+        case Kind::Custom:
+            if(prepare != nullptr) {
+                prepare(sqe, *this);
+            } else {
+                io_uring_prep_nop(sqe);
+            }
+            break;
+        default:
+            io_uring_prep_nop(sqe);
+            break;
+    }
+
+    if(isBufferSelect())
+    {
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = static_cast<__u16>(bufferGroup);
+    }
+
+    if(isDirectFd(fd) && sqe->fd == fd)
+    {
+        sqe->fd = static_cast<__s32>(directIndex(fd));
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+}
+
 AIOUringOp AIOUringOp::ShutdownUring(int code) {
     return AIOUringOp {
-            .shutdown = true,
-            .shutdownCode = code
+            .kind = Kind::ShutdownUring,
+            .flags = code
+    };
+}
+
+AIOUringOp AIOUringOp::Yield() {
+    return AIOUringOp {
+            .kind = Kind::Yield
+    };
+}
+
+AIOUringOp AIOUringOp::Park(void *task) {
+    return AIOUringOp {
+            .kind = Kind::Park,
+            .addr = task
+    };
+}
+
+AIOUringOp AIOUringOp::LongTask() {
+    return AIOUringOp {
+            .kind = Kind::LongTask
+    };
+}
+
+AIOUringOp AIOUringOp::Deadline(std::chrono::steady_clock::time_point deadline) {
+    auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+
+    return AIOUringOp {
+            .kind = Kind::Deadline,
+            .timeoutNs = static_cast<__u64>(std::max(sinceEpoch.count(), std::chrono::nanoseconds::rep{0}))
     };
 }
 
 AIOUringOp AIOUringOp::Nop() {
     return AIOUringOp {
-        .submit = [=](io_uring *ring, __u64 ptrTask) {
-            struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-            io_uring_prep_nop(sqe);
-            sqe->user_data = ptrTask;
-        }
+            .kind = Kind::Nop
     };
 }
 
 AIOUringOp AIOUringOp::Read(int fd, void *buf, size_t buf_size, __u64 offset) {
     return AIOUringOp {
-            .submit = [=](io_uring *ring, __u64 ptrTask) {
-                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-                io_uring_prep_read(sqe, fd, buf, buf_size, offset);
-                sqe->user_data = ptrTask;
-            }
+            .kind = Kind::Read,
+            .fd = fd,
+            .addr = buf,
+            .len = static_cast<__u32>(buf_size),
+            .offset = offset
     };
 }
 
 AIOUringOp AIOUringOp::Write(int fd, void *buf, size_t buf_size, __u64 offset) {
     return AIOUringOp {
-            .submit = [=](io_uring *ring, __u64 ptrTask) {
-                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-                io_uring_prep_write(sqe, fd, buf, buf_size, offset);
-                sqe->user_data = ptrTask;
-            }
+            .kind = Kind::Write,
+            .fd = fd,
+            .addr = buf,
+            .len = static_cast<__u32>(buf_size),
+            .offset = offset
+    };
+}
+
+AIOUringOp AIOUringOp::Recv(int fd, void *buf, size_t buf_size, int flags) {
+    return AIOUringOp {
+            .kind = Kind::Recv,
+            .fd = fd,
+            .addr = buf,
+            .len = static_cast<__u32>(buf_size),
+            .flags = flags
+    };
+}
+
+AIOUringOp AIOUringOp::ReadFixed(int fd, void *buf, size_t buf_size, unsigned bufIndex, __u64 offset) {
+    return AIOUringOp {
+            .kind = Kind::ReadFixed,
+            .fd = fd,
+            .addr = buf,
+            .len = static_cast<__u32>(buf_size),
+            .offset = offset,
+            .bufferIndex = bufIndex
+    };
+}
+
+AIOUringOp AIOUringOp::WriteFixed(int fd, const void *buf, size_t buf_size, unsigned bufIndex, __u64 offset) {
+    return AIOUringOp {
+            .kind = Kind::WriteFixed,
+            .fd = fd,
+            .addr = const_cast<void *>(buf),
+            .len = static_cast<__u32>(buf_size),
+            .offset = offset,
+            .bufferIndex = bufIndex
+    };
+}
+
+AIOUringOp AIOUringOp::Readv(int fd, const struct iovec *iovecs, unsigned count, __u64 offset) {
+    return AIOUringOp {
+            .kind = Kind::Readv,
+            .fd = fd,
+            .addr = const_cast<iovec *>(iovecs),
+            .len = count,
+            .offset = offset
+    };
+}
+
+AIOUringOp AIOUringOp::Writev(int fd, const struct iovec *iovecs, unsigned count, __u64 offset) {
+    return AIOUringOp {
+            .kind = Kind::Writev,
+            .fd = fd,
+            .addr = const_cast<iovec *>(iovecs),
+            .len = count,
+            .offset = offset
+    };
+}
+
+AIOUringOp AIOUringOp::SendMsg(int fd, const struct msghdr *msg, int flags) {
+    return AIOUringOp {
+            .kind = Kind::SendMsg,
+            .fd = fd,
+            .addr = const_cast<msghdr *>(msg),
+            .flags = flags
+    };
+}
+
+AIOUringOp AIOUringOp::RecvMsg(int fd, struct msghdr *msg, int flags) {
+    return AIOUringOp {
+            .kind = Kind::RecvMsg,
+            .fd = fd,
+            .addr = msg,
+            .flags = flags
+    };
+}
+
+AIOUringOp AIOUringOp::ReadSelect(int fd, int bufferGroup, void *buf, size_t buf_size) {
+    AIOUringOp op = Read(fd, bufferGroup >= 0 ? nullptr : buf, buf_size);
+    op.bufferGroup = bufferGroup;
+    return op;
+}
+
+AIOUringOp AIOUringOp::RecvSelect(int fd, int bufferGroup, void *buf, size_t buf_size, int flags) {
+    AIOUringOp op = Recv(fd, bufferGroup >= 0 ? nullptr : buf, buf_size, flags);
+    op.bufferGroup = bufferGroup;
+    return op;
+}
+
+AIOUringOp AIOUringOp::RecvMultishot(int fd, int bufferGroup, int flags) {
+    return AIOUringOp {
+            .kind = Kind::RecvMultishot,
+            .fd = fd,
+            .flags = flags,
+            .bufferGroup = bufferGroup
+    };
+}
+
+AIOUringOp AIOUringOp::SendZC(int fd, const void *buf, size_t buf_size, int flags) {
+    return AIOUringOp {
+            .kind = Kind::SendZC,
+            .fd = fd,
+            .addr = const_cast<void *>(buf),
+            .len = static_cast<__u32>(buf_size),
+            .flags = flags
+    };
+}
+
+AIOUringOp AIOUringOp::SendZCFixed(int fd, const void *buf, size_t buf_size, unsigned bufIndex, int flags) {
+    return AIOUringOp {
+            .kind = Kind::SendZCFixed,
+            .fd = fd,
+            .addr = const_cast<void *>(buf),
+            .len = static_cast<__u32>(buf_size),
+            .flags = flags,
+            .bufferIndex = bufIndex
+    };
+}
+
+AIOUringOp AIOUringOp::ZeroCopyFlush(unsigned keepPending) {
+    return AIOUringOp {
+            .kind = Kind::ZeroCopyFlush,
+            .len = keepPending
+    };
+}
+
+AIOUringOp AIOUringOp::Splice(int fdIn, int fdOut, size_t len, unsigned flags) {
+    return AIOUringOp {
+            .kind = Kind::Splice,
+            .fd = fdOut,
+            .len = static_cast<__u32>(len),
+            .offset = static_cast<__u64>(fdIn),
+            .flags = static_cast<int>(flags)
+    };
+}
+
+AIOUringOp AIOUringOp::Poll(int fd, unsigned mask) {
+    return AIOUringOp {
+            .kind = Kind::Poll,
+            .fd = fd,
+            .len = mask
     };
 }
 
 AIOUringOp AIOUringOp::Accept(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags) {
     return AIOUringOp {
-            .submit = [=](io_uring *ring, __u64 ptrTask) {
-                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-                io_uring_prep_accept(sqe, fd, addr, addrlen, flags);
-                sqe->user_data = ptrTask;
-            }
+            .kind = Kind::Accept,
+            .fd = fd,
+            .addr = addr,
+            .addr2 = addrlen,
+            .flags = flags
+    };
+}
+
+AIOUringOp AIOUringOp::AcceptDirect(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags) {
+    return AIOUringOp {
+            .kind = Kind::Accept,
+            .fd = fd,
+            .addr = addr,
+            .addr2 = addrlen,
+            .len = IORING_FILE_INDEX_ALLOC,
+            .flags = flags
+    };
+}
+
+AIOUringOp AIOUringOp::AcceptMultishot(int fd, int flags) {
+    return AIOUringOp {
+            .kind = Kind::AcceptMultishot,
+            .fd = fd,
+            .flags = flags
+    };
+}
+
+AIOUringOp AIOUringOp::AcceptMultishotDirect(int fd, int flags) {
+    return AIOUringOp {
+            .kind = Kind::AcceptMultishot,
+            .fd = fd,
+            .len = IORING_FILE_INDEX_ALLOC,
+            .flags = flags
     };
 }
 
 AIOUringOp AIOUringOp::Close(int fd) {
     return AIOUringOp {
-            .submit = [=](io_uring *ring, __u64 ptrTask) {
-                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-                io_uring_prep_close(sqe, fd);
-                sqe->user_data = ptrTask;
-            }
+            .kind = Kind::Close,
+            .fd = fd
     };
 }
 
 AIOUringOp AIOUringOp::Connect(int fd, const struct sockaddr *addr, socklen_t addrlen) {
     return AIOUringOp {
-            .submit = [=](io_uring *ring, __u64 ptrTask) {
-                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-                io_uring_prep_connect(sqe, fd, addr, addrlen);
-                sqe->user_data = ptrTask;
-            }
+            .kind = Kind::Connect,
+            .fd = fd,
+            .addr = const_cast<sockaddr *>(addr),
+            .len = addrlen
     };
 }
 
 AIOUringOp AIOUringOp::Shutdown(int fd, int how) {
     return AIOUringOp {
-            .submit = [=](io_uring *ring, __u64 ptrTask) {
-                struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
-                io_uring_prep_shutdown(sqe, fd, how);
-                sqe->user_data = ptrTask;
-            }
+            .kind = Kind::Shutdown,
+            .fd = fd,
+            .len = static_cast<__u32>(how)
+    };
+}
+
+AIOUringOp AIOUringOp::Timeout(std::chrono::nanoseconds timeout) {
+    return AIOUringOp {
+            .kind = Kind::Timeout,
+            .timeoutNs = static_cast<__u64>(std::max(timeout.count(), std::chrono::nanoseconds::rep{1}))
+    };
+}
+
+AIOUringOp AIOUringOp::InstallFile(int *fd) {
+    return AIOUringOp {
+            .kind = Kind::InstallFile,
+            .addr = fd
+    };
+}
+
+AIOUringOp AIOUringOp::withTimeout(std::chrono::nanoseconds timeout) const {
+    AIOUringOp op = *this;
+    op.timeoutNs = timeout.count() > 0 ? static_cast<__u64>(timeout.count()) : 0;
+    return op;
+}
+
+AIOUringOp AIOUringOp::Custom(Prepare prepare, int fd, void *addr, __u32 len, __u64 offset, int flags) {
+    return AIOUringOp {
+            .kind = Kind::Custom,
+            .fd = fd,
+            .addr = addr,
+            .len = len,
+            .offset = offset,
+            .flags = flags,
+            .prepare = prepare
     };
 }
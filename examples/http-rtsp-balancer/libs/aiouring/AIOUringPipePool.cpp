@@ -0,0 +1,78 @@
+#include "include/aiouring/AIOUringPipePool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+AIOUringPipePool::AIOUringPipePool(size_t maxIdle, size_t pipeSize) :
+        maxIdle{maxIdle}, pipeSize{pipeSize} {
+    idle.reserve(maxIdle);
+}
+
+AIOUringPipePool::~AIOUringPipePool() {
+    for(auto pipe : idle)
+    {
+        close(pipe);
+    }
+}
+
+std::optional<AIOUringPipe> AIOUringPipePool::acquire() {
+    ++inUse;
+
+    if(!idle.empty())
+    {
+        AIOUringPipe pipe = idle.back();
+        idle.pop_back();
+        ++reused;
+        return pipe;
+    }
+
+    int fds[2];
+
+    if(pipe2(fds, O_CLOEXEC) < 0)
+    {
+        --inUse;
+        return std::nullopt;
+    }
+
+    if(pipeSize > 0)
+    {
+        // best effort, the limit is /proc/sys/fs/pipe-max-size
+        fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(pipeSize));
+    }
+
+    ++created;
+
+    return AIOUringPipe {
+            .readFd = fds[0],
+            .writeFd = fds[1]
+    };
+}
+
+void AIOUringPipePool::release(AIOUringPipe pipe, bool drained) {
+    --inUse;
+
+    if(drained && idle.size() < maxIdle)
+    {
+        idle.push_back(pipe);
+        return;
+    }
+
+    ++discarded;
+    close(pipe);
+}
+
+AIOUringPipePoolStats AIOUringPipePool::getStats() const {
+    return AIOUringPipePoolStats {
+            .idle = idle.size(),
+            .maxIdle = maxIdle,
+            .inUse = inUse,
+            .created = created,
+            .reused = reused,
+            .discarded = discarded
+    };
+}
+
+void AIOUringPipePool::close(AIOUringPipe pipe) {
+    ::close(pipe.readFd);
+    ::close(pipe.writeFd);
+}
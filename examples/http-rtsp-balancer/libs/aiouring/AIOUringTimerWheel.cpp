@@ -0,0 +1,179 @@
+#include "include/aiouring/AIOUringTimerWheel.h"
+
+#include <algorithm>
+
+AIOUringTimerWheel::AIOUringTimerWheel(Clock::time_point origin) : origin{origin} {
+
+}
+
+bool AIOUringTimerWheel::arm(AIOUringTimer *timer, Clock::time_point deadline) {
+    cancel(timer);
+
+    const uint64_t expiresTick = ticksCeil(deadline);
+
+    if(expiresTick <= currentTick)
+    {
+        return false;
+    }
+
+    timer->expiresTick = expiresTick;
+    insert(timer);
+    ++armed;
+
+    return true;
+}
+
+void AIOUringTimerWheel::cancel(AIOUringTimer *timer) {
+    if(!timer->isArmed())
+    {
+        return;
+    }
+
+    if(timer->prev != nullptr)
+    {
+        timer->prev->next = timer->next;
+    }
+    else
+    {
+        slots[timer->slot] = timer->next;
+    }
+
+    if(timer->next != nullptr)
+    {
+        timer->next->prev = timer->prev;
+    }
+
+    if(slots[timer->slot] == nullptr)
+    {
+        occupied[timer->slot / slotsPerLevel] &= ~(uint64_t{1} << (timer->slot % slotsPerLevel));
+    }
+
+    timer->prev = nullptr;
+    timer->next = nullptr;
+    timer->slot = -1;
+    --armed;
+}
+
+std::optional<AIOUringTimerWheel::Clock::time_point> AIOUringTimerWheel::nextExpiry() const {
+    if(armed == 0)
+    {
+        return std::nullopt;
+    }
+
+    // the first level with an occupied slot ahead holds the earliest event, for upper
+    // levels it is the cascade of the slot, which re-inserts its timers
+    for(unsigned level = 0; level < levels; ++level)
+    {
+        const unsigned shift = level * levelBits;
+        const uint64_t index = (currentTick >> shift) & slotMask;
+        const uint64_t pending = index == slotMask ? 0 : occupied[level] & (~uint64_t{0} << (index + 1));
+
+        if(pending != 0)
+        {
+            const unsigned upperShift = shift + levelBits;
+            const uint64_t eventTick = ((currentTick >> upperShift) << upperShift) +
+                                       (static_cast<uint64_t>(std::countr_zero(pending)) << shift);
+
+            return origin + eventTick * tick;
+        }
+    }
+
+    // only far timers parked behind the current slot of the top level are left
+    const unsigned shift = (levels - 1) * levelBits;
+    const unsigned upperShift = levels * levelBits;
+    const uint64_t eventTick = (((currentTick >> upperShift) + 1) << upperShift) +
+                               (static_cast<uint64_t>(std::countr_zero(occupied[levels - 1])) << shift);
+
+    return origin + eventTick * tick;
+}
+
+size_t AIOUringTimerWheel::size() const {
+    return armed;
+}
+
+uint64_t AIOUringTimerWheel::ticksFloor(Clock::time_point timePoint) const {
+    if(timePoint <= origin)
+    {
+        return 0;
+    }
+
+    return static_cast<uint64_t>((timePoint - origin) / tick);
+}
+
+uint64_t AIOUringTimerWheel::ticksCeil(Clock::time_point timePoint) const {
+    if(timePoint <= origin)
+    {
+        return 0;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint - origin);
+
+    return static_cast<uint64_t>((elapsed + tick - std::chrono::nanoseconds{1}) / tick);
+}
+
+void AIOUringTimerWheel::insert(AIOUringTimer *timer) {
+    const uint64_t expiresTick = std::max(timer->expiresTick, currentTick);
+    const uint64_t diff = expiresTick ^ currentTick;
+    // level of the highest 6-bit group which differs from the current tick
+    unsigned level = diff == 0 ? 0 : static_cast<unsigned>(std::bit_width(diff) - 1) / levelBits;
+    uint64_t index;
+
+    if(level >= levels)
+    {
+        level = levels - 1;
+
+        const unsigned shift = level * levelBits;
+        // within the next rotation of the top level the slot is simply reached later,
+        // the rest waits in the farthest slot and is re-inserted on its cascade
+        index = (expiresTick >> shift) - (currentTick >> shift) < slotsPerLevel ?
+                (expiresTick >> shift) & slotMask :
+                ((currentTick >> shift) - 1) & slotMask;
+    }
+    else
+    {
+        index = (expiresTick >> (level * levelBits)) & slotMask;
+    }
+
+    const auto slot = static_cast<int>(level * slotsPerLevel + index);
+
+    timer->slot = slot;
+    timer->prev = nullptr;
+    timer->next = slots[slot];
+
+    if(timer->next != nullptr)
+    {
+        timer->next->prev = timer;
+    }
+
+    slots[slot] = timer;
+    occupied[level] |= uint64_t{1} << index;
+}
+
+AIOUringTimer *AIOUringTimerWheel::takeSlot(unsigned slot) {
+    AIOUringTimer *timer = slots[slot];
+
+    slots[slot] = nullptr;
+    occupied[slot / slotsPerLevel] &= ~(uint64_t{1} << (slot % slotsPerLevel));
+
+    return timer;
+}
+
+void AIOUringTimerWheel::cascade() {
+    for(unsigned level = 1; level < levels; ++level)
+    {
+        const uint64_t index = (currentTick >> (level * levelBits)) & slotMask;
+        AIOUringTimer *timer = takeSlot(level * slotsPerLevel + index);
+
+        while(timer != nullptr)
+        {
+            AIOUringTimer *next = timer->next;
+            insert(timer);
+            timer = next;
+        }
+
+        if(index != 0)
+        {
+            break;
+        }
+    }
+}
@@ -6,6 +6,8 @@
 #define AIOURING_H
 
 #include <atomic>
+#include <bitset>
+#include <condition_variable>
 #include <liburing.h>
 #include <fmt/core.h>
 #include <aioutils/ulinux.h>
@@ -14,10 +16,23 @@
 #include <thread>
 #include <taskflow/taskflow.hpp>
 #include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <deque>
+#include <mutex>
 #include <tuple>
+#include <unordered_map>
 
 #include "AIOUringTask.h"
 #include "AIOUringLongTask.h"
+#include "AIOUringBlockingPool.h"
+#include "AIOUringTaskPool.h"
+#include "AIOUringTimerWheel.h"
+#include "AIOUringFrameAllocator.h"
+#include "AIOUringBufferRing.h"
+#include "AIOUringPipePool.h"
+#include "AIOUringFixedBuffers.h"
+#include "AIOUringMessage.h"
+#include "AIOUringBalancer.h"
 
 class AIOUringException : public std::exception {
 public:
@@ -33,19 +48,79 @@ private:
     std::string message;
 };
 
+/**
+ * Optional io_uring_setup() flags. A flag the kernel doesn't support is dropped with a
+ * warning, the ring is set up without it.
+ */
+struct AIOUringSetupOptions {
+    // submission queue size, rounded up to a power of 2
+    unsigned sqEntries{4096};
+    // completion queue size (IORING_SETUP_CQSIZE), 0 - twice sqEntries
+    unsigned cqEntries{0};
+    // IORING_SETUP_SQPOLL (5.11), a kernel thread polls the submission queue
+    bool sqPoll{false};
+    // time without submissions after which the SQPOLL thread goes to sleep
+    std::chrono::milliseconds sqThreadIdle{2000};
+    // cpu of the SQPOLL thread (IORING_SETUP_SQ_AFF), std::nullopt - not bound; AIOUringRuntime
+    // binds the thread of each next ring to the next cpu the process may run on
+    std::optional<unsigned> sqThreadCpu{std::nullopt};
+    // IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN (6.1): completions run only when
+    // the ring waits for them, on the ring thread; not compatible with sqPoll. The thread which
+    // calls setup() must be the only one to submit and run() the ring, as in AIOUringRuntime
+    bool deferTaskrun{false};
+    // IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG (5.19): no interrupt of the ring
+    // thread to run completions; not compatible with sqPoll
+    bool coopTaskrun{false};
+    // io_uring_register_ring_fd (5.18), io_uring_enter() skips the fd lookup; the registration
+    // belongs to the thread which calls setup()
+    bool registerRingFd{false};
+    // rings of the process sharing RLIMIT_MEMLOCK, each registers buffers for at most half of
+    // the limit divided by this; AIOUringRuntime sets it to the number of its rings
+    unsigned lockedMemoryShares{1};
+};
+
+struct AIOUringRingStats {
+    unsigned sqEntries{0};
+    unsigned cqEntries{0};
+    // submissions which found the SQ full and flushed it to the kernel
+    uint64_t sqFull{0};
+    // submissions left for the next loop iteration because the SQ stayed full, and waiting now
+    uint64_t sqDeferred{0};
+    size_t sqBacklog{0};
+    // times the CQ overflowed into the kernel backlog (IORING_SQ_CQ_OVERFLOW)
+    uint64_t cqOverflows{0};
+    // CQEs the kernel had to drop
+    uint64_t cqDropped{0};
+};
+
 class AIOUring {
 public:
     explicit AIOUring(std::optional<int> iouringBackend = std::nullopt, bool useSQPoll = false);
+    AIOUring(std::optional<int> iouringBackend, AIOUringSetupOptions setupOptions);
+    ~AIOUring();
 
     [[nodiscard]] int getInstanceId() const;
+    [[nodiscard]] int getRingFd() const;
 
     void setup();
     int run();
+    void stop(int code = 0);
+    // fire and forget, the eventfd of longTask is written when the job is done
     void executeLongTask(AIOUringLongTask longTask);
+    // job(tf::Executor *) runs in the blocking pool, the task waits for it with AIOUringOp::LongTask();
+    // a task canceled meanwhile gets -ECANCELED only once the job is done
+    template<typename F>
+    void awaitLongTask(AIOUringTask *task, const AIOUringJobOptions &options, F &&job);
+    // the value returned by the job is assigned to *target on the pool thread
+    template<typename R, typename F>
+    void awaitLongTask(AIOUringTask *task, const AIOUringJobOptions &options, R *target, F &&job);
+    // AIOUringBlockingPool::shared() unless set before the first long task
+    void setBlockingPool(AIOUringBlockingPool *pool);
+    AIOUringBlockingPool &getBlockingPool();
 
     template<typename T, typename... Args>
     requires Derived<T, AIOUringTask> && IsFinal<T> && AIOUringTaskTrait<T>
-    T* newTask(Args... args);
+    T* newTask(Args&&... args);
 
     template<Derived<AIOUringTask> T>
     requires AIOUringTaskTrait<T>
@@ -55,17 +130,219 @@ public:
     requires AIOUringTaskTrait<T>
     void pushTask(T* task);
 
+    AIOUringTaskRef getTaskRef(AIOUringTask *task);
+    bool wake(AIOUringTaskRef ref);
+    bool cancelTask(AIOUringTask *task);
+    bool cancelTask(AIOUringTaskRef ref);
+
+    // on the ring thread; false if target has left run() or a direct fd can't be passed to it,
+    // the fd stays with the caller
+    bool sendTo(AIOUring *target, AIOUringMessage message);
+    void setMessageHandler(uint32_t type, AIOUringMessageHandler handler);
+    // each message of the type starts a new T(AIOUring *, AIOUringMessage)
+    template<typename T>
+    requires Derived<T, AIOUringTask> && IsFinal<T> && AIOUringTaskTrait<T>
+    void setMessageTask(uint32_t type);
+    // IORING_OP_MSG_RING can post to this ring, otherwise messages come through its queue
+    [[nodiscard]] bool acceptsMessageRing() const;
+    [[nodiscard]] AIOUringMessageStats getMessageStats() const;
+
+    // any thread; rates as of the last sample of the ring
+    [[nodiscard]] AIOUringLoad getLoad() const;
+    // new work: goes to a cooler ring of the balancer, or waits here to be run or stolen by an
+    // idle ring; dispatched right away without a balancer
+    void distribute(AIOUringMessage message);
+    // any thread: wakes the ring to look for work to steal
+    void nudge();
+    [[nodiscard]] AIOUringBalanceStats getBalanceStats() const;
+
+    // sparse registered file table, see AIOUringOp::directFd()
+    [[nodiscard]] bool hasFileTable() const;
+    [[nodiscard]] bool supportsMultishotAccept() const;
+    [[nodiscard]] bool supportsMultishotRecv() const;
+
+    // provided buffer rings, see AIOUringOp::ReadSelect()
+    AIOUringBufferRing &registerBufferGroup(uint16_t groupId, unsigned buffers, size_t bufferSize);
+    [[nodiscard]] bool hasBufferGroup(int groupId) const;
+    // group registered by setup() for reads of sockets, -1 if the kernel has no buffer rings
+    [[nodiscard]] int getReadBufferGroup() const;
+    // buffer selected for the completion being polled right now, empty if there is none
+    AIOUringBuffer takeBuffer(int ioResult);
+    [[nodiscard]] std::vector<AIOUringBufferGroupStats> getBufferGroupStats() const;
+
+    // registered buffers, see AIOUringOp::ReadFixed(); false until the first lease registers them
+    [[nodiscard]] bool hasFixedBuffers() const;
+    // empty if the buffers can't be registered or all of them are leased
+    AIOUringFixedBuffer leaseFixedBuffer();
+    [[nodiscard]] std::optional<AIOUringFixedBufferStats> getFixedBufferStats() const;
+
+    // opcodes the kernel reported through IORING_REGISTER_PROBE
+    [[nodiscard]] bool isOpSupported(int opcode) const;
+    // sinks send payloads of at least this size with SendZC and lease registered buffers for it,
+    // 0 - never (the default)
+    void setZeroCopyThreshold(size_t threshold);
+    [[nodiscard]] size_t getZeroCopyThreshold() const;
+    // the buffer goes back to its ring after the notifications of all SendZC of the task sent so far
+    void releaseAfterZeroCopy(AIOUringTask *task, AIOUringBuffer buffer);
+
+    // pipes for splice relays, see AIOUringOp::Splice()
+    std::optional<AIOUringPipe> acquirePipe();
+    void releasePipe(AIOUringPipe pipe, bool drained);
+    [[nodiscard]] AIOUringPipePoolStats getPipePoolStats() const;
+
+    [[nodiscard]] AIOUringRingStats getRingStats() const;
+    [[nodiscard]] AIOUringLongTaskStats getLongTaskStats() const;
+    [[nodiscard]] std::vector<AIOUringTaskPoolStats> getTaskPoolStats() const;
+    [[nodiscard]] std::vector<AIOUringTaskPoolStats> getFramePoolStats() const;
+
 private:
+    friend class AIOUringBalancer;
+
     inline static std::atomic<int> idGenerator{0};
     io_uring_params params{};
     io_uring ring{};
+    // io_uring_queue_exit() is due in the destructor
+    bool ringInitialized{false};
     bool setupPassed{false};
     int instanceId{-1};
     std::optional<int> iouringBackend{std::nullopt};
-    bool useSQPoll{false};
-    tf::Executor executor{};
+    AIOUringSetupOptions setupOptions{};
+    AIOUringBlockingPool *blockingPool{nullptr};
+    // finished jobs of the blocking pool
+    AIOUringLongTaskQueue longTaskCompletions{};
+    std::atomic<uint64_t> longTaskWakeups{0};
+    // jobs the pool hasn't returned from yet, the ring waits for them when destroyed
+    std::mutex longTaskJobsMutex{};
+    std::condition_variable longTaskJobsDone{};
+    size_t longTaskJobs{0};
+    // messages of rings which can't use IORING_OP_MSG_RING
+    AIOUringMessageQueue messages{};
+    std::unordered_map<uint32_t, AIOUringMessageHandler> messageHandlers{};
+    AIOUringMessageStats messageStats{};
+    // set by AIOUringBalancer::attach() while the ring runs in a runtime
+    AIOUringBalancer *balancer{nullptr};
+    AIOUringLoadMeter loadMeter{};
+    // plain fd messages of distribute() any ring may take, the ring runs a batch per iteration
+    std::mutex offeredMutex{};
+    std::deque<AIOUringMessage> offered{};
+    std::atomic<bool> nudged{false};
+    AIOUringBalanceStats balanceStats{};
+    std::atomic<uint64_t> stolenFrom{0};
+    int wakeupfd{-1};
+    eventfd_t wakeupSink{};
+    unsigned fileTableSize{0};
+    bool multishotAccept{false};
+    bool multishotRecv{false};
+    std::bitset<256> supportedOps{};
+    bool messageRing{false};
+    bool messageRingFd{false};
+    size_t zeroCopyThreshold{0};
+    std::atomic<bool> stopRequested{false};
+    // run() has returned, messages sent from now on would never be received
+    std::atomic<bool> finished{false};
+    std::atomic<int> stopCode{0};
+
+    // per task type slab pools, indexed by AIOUringTaskTypes::id<T>()
+    std::vector<std::unique_ptr<AIOUringTaskPool>> taskPools{};
+    AIOUringTask *readyHead{nullptr};
+    AIOUringTask *readyTail{nullptr};
+    size_t readyCount{0};
+    uint64_t taskIdGenerator{0};
+    // tasks handed out through getTaskRef(), by task id
+    std::unordered_map<uint64_t, AIOUringTask *> wakeableTasks{};
+    AIOUringTimerWheel timerWheel{};
+    AIOUringFrameAllocator frameAllocator{};
+    std::unordered_map<uint16_t, std::unique_ptr<AIOUringBufferRing>> bufferGroups{};
+    AIOUringPipePool pipePool;
+    std::unique_ptr<AIOUringFixedBuffers> fixedBuffers{};
+    // the buffers are registered on the first lease, only once
+    bool fixedBuffersTried{false};
+    int readBufferGroup{-1};
+    // buffer of the CQE being processed, recycled if the task doesn't take it
+    AIOUringBufferRing *cqeBufferRing{nullptr};
+    uint16_t cqeBufferId{0};
+    // buffer-select ops which got -ENOBUFS, resubmitted once their group has buffers again
+    std::deque<AIOUringTask *> bufferWaiters{};
+
+    struct MultishotCompletion {
+        int result{0};
+        unsigned flags{0};
+    };
+
+    // multishot CQEs which came while their task wasn't waiting for them
+    std::unordered_map<AIOUringTask *, std::deque<MultishotCompletion>> multishotCompletions{};
+    struct DeferredSqe {
+        AIOUringOp op{};
+        AIOUringTask *task{nullptr};
+        // without a task - cancel of this user_data
+        __u64 cancelUserData{0};
+    };
+
+    // submissions which found the SQ full even after flushing it, submitted before the next wait
+    std::deque<DeferredSqe> deferredSqes{};
+    bool wakeupDeferred{false};
+    AIOUringRingStats ringStats{};
+    bool cqOverflow{false};
+
+    AIOUringLongTaskStats longTaskStats{};
+    uint64_t longTaskQueueWaitSumNs{0};
+    uint64_t longTaskResumeLatencySumNs{0};
+
+    // buffers released on the SendZC notification with the paired sequence number
+    std::unordered_map<AIOUringTask *, std::deque<std::pair<uint64_t, AIOUringBuffer>>> zeroCopyBuffers{};
+
+    void scheduleTask(AIOUringTask *task, int ioResult = 0, unsigned cqeFlags = 0);
+    std::tuple<bool, int> runReadyTasks();
+    std::tuple<bool, int> processTask(AIOUringTask *task, int ioResult);
+    void submitOp(const AIOUringOp &op, AIOUringTask *task);
+    void submitCancel(__u64 userData);
+    void awaitMultishot(const AIOUringOp &op, AIOUringTask *task);
+    void armMultishot(const AIOUringOp &op, AIOUringTask *task);
+    io_uring_sqe *getSqe(unsigned count = 1);
+    void flushDeferredSqes();
+    void checkCqOverflow();
+    std::tuple<bool, int> completeMultishot(AIOUringTask *task, int ioResult, unsigned cqeFlags);
+    void dropMultishotBacklog(AIOUringTask *task);
+    // recycles the buffer of the completion and closes the socket it accepted
+    void discardMultishotCompletion(AIOUringTask *task, int ioResult, unsigned cqeFlags);
+    void completeZeroCopy(AIOUringTask *task);
+    void submitLongTask(AIOUringTask *task, const AIOUringJobOptions &options,
+                        std::function<int(tf::Executor *)> job);
+    void pushLongTaskCompletion(AIOUringLongTaskCompletion *completion);
+    void drainLongTasks();
+    int runLoop();
+    void pushMessage(AIOUringMessageNode *node);
+    void drainMessages();
+    // closes the fds of messages which came after run() had returned
+    void dropUndeliveredMessages();
+    void completeMessageSend(AIOUringMessageNode *node, int result);
+    void receiveMessage(AIOUringMessageNode *node, int result);
+    void dispatchMessage(AIOUringMessage message);
+    void closeFd(int fd);
+    void balanceLoad();
+    void runOffered();
+    void stealOffered();
+    // up to number of the oldest offered messages
+    std::deque<AIOUringMessage> takeOffered(size_t number);
+    void probeOps();
+    void setupFixedBuffers();
+    unsigned optionalSetupFlags();
+    void initRing();
+    void parkTask(AIOUringTask *task, AIOUringTask *root);
+    void sleepTask(AIOUringTask *task, AIOUringTimerWheel::Clock::time_point deadline);
+    void expireTimers();
+    int submitAndWait();
 
-    std::tuple<bool, int> processCQE(io_uring_cqe *cqe);
+    template<typename T>
+    AIOUringTaskPool &getTaskPool();
+    void armWakeup();
+    void setupFileTable();
+    void setupReadBufferGroup();
+    void resumeBufferWaiters();
+    void holdCqeBuffer(int bufferGroup, unsigned cqeFlags);
+    void selectCqeBuffer(int bufferGroup, unsigned cqeFlags);
+    void recycleCqeBuffer(int bufferGroup, unsigned cqeFlags);
+    void releaseCqeBuffer();
 };
 
 #include "AIOUring.tpp"
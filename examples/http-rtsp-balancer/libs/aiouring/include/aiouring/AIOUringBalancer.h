@@ -0,0 +1,115 @@
+#ifndef AIOURINGBALANCER_H
+#define AIOURINGBALANCER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class AIOUring;
+
+struct AIOUringLoad {
+    // bytes moved by the data ops of the ring, a relayed byte counts on both sockets
+    uint64_t bytesPerSec{0};
+    uint64_t cqesPerSec{0};
+    // tasks alive on the ring
+    uint64_t tasks{0};
+    // share of the time the ring wasn't waiting for completions, 0 - 1000
+    uint32_t busyPermille{0};
+    // connections steered to the ring since its last sample
+    uint32_t steeredIn{0};
+    // work offered by the ring and not taken yet, see AIOUring::distribute()
+    size_t offered{0};
+};
+
+/**
+ * Load counters of one ring. The ring thread counts and publishes the rates once per
+ * interval, other threads read the published load.
+ */
+class AIOUringLoadMeter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void addBytes(uint64_t number) { bytes += number; }
+    void addCqes(uint64_t number) { cqes += number; }
+    void addIdle(Clock::duration duration) { idle += duration; }
+    void taskCreated() { ++tasks; }
+    void taskFreed() { --tasks; }
+    void setOffered(size_t number) { offered.store(number, std::memory_order_relaxed); }
+    // any thread
+    void noteSteeredIn() { steeredIn.fetch_add(1, std::memory_order_relaxed); }
+
+    // true if the interval has passed and the rates have been published
+    bool sample(Clock::time_point now, Clock::duration interval);
+    [[nodiscard]] Clock::time_point nextSample(Clock::duration interval) const;
+    // any thread
+    [[nodiscard]] AIOUringLoad load() const;
+private:
+    uint64_t bytes{0};
+    uint64_t cqes{0};
+    Clock::duration idle{};
+    uint64_t tasks{0};
+    Clock::time_point sampledAt{Clock::now()};
+    std::atomic<uint64_t> bytesPerSec{0};
+    std::atomic<uint64_t> cqesPerSec{0};
+    std::atomic<uint64_t> tasksNow{0};
+    std::atomic<uint32_t> busyPermille{0};
+    std::atomic<uint32_t> steeredIn{0};
+    std::atomic<size_t> offered{0};
+};
+
+struct AIOUringBalanceOptions {
+    // a ring hands its new connections to cooler rings
+    bool steerAccepts{true};
+    // idle rings take the offered work of loaded rings
+    bool stealWork{true};
+    // a ring is hot while its bytes/s exceed those of another ring this many times...
+    double hotRatio{1.5};
+    // ...and this floor, below it the load isn't worth balancing
+    uint64_t minBytesPerSec{8 * 1024 * 1024};
+    // offered work a ring keeps before an idle ring is woken to take it
+    size_t stealThreshold{8};
+    std::chrono::milliseconds sampleInterval{250};
+};
+
+struct AIOUringBalanceStats {
+    // connections sent to cooler rings
+    uint64_t steered{0};
+    // work offered for stealing, taken by this ring from others and by others from this one
+    uint64_t offered{0};
+    uint64_t stolen{0};
+    uint64_t stolenFrom{0};
+};
+
+/**
+ * Load table of the rings of an AIOUringRuntime: steers new connections from hot rings to
+ * cooler ones and picks the ring an idle ring steals offered work from. Only work which
+ * hasn't started migrates: a task belongs to the ring which created it.
+ */
+class AIOUringBalancer {
+public:
+    AIOUringBalancer(size_t ringsNumber, AIOUringBalanceOptions options);
+    AIOUringBalancer(const AIOUringBalancer &) = delete;
+    AIOUringBalancer &operator=(const AIOUringBalancer &) = delete;
+
+    // on the thread of the ring, before it runs
+    void attach(size_t index, AIOUring *aioUring);
+    void detach(size_t index);
+
+    [[nodiscard]] const AIOUringBalanceOptions &getOptions() const;
+    // cooler ring for a new connection of from, nullptr - from keeps it
+    AIOUring *steerTarget(AIOUring *from);
+    // ring with the most offered work, nullptr if no other ring offers any
+    AIOUring *stealVictim(AIOUring *thief);
+    // wakes the least busy ring without offered work of its own to steal from from
+    void wakeThief(AIOUring *from);
+    [[nodiscard]] std::vector<AIOUringLoad> getLoads() const;
+private:
+    size_t ringsNumber;
+    AIOUringBalanceOptions options;
+    std::unique_ptr<std::atomic<AIOUring *>[]> rings;
+};
+
+#endif //AIOURINGBALANCER_H
@@ -0,0 +1,144 @@
+#ifndef AIOURINGBLOCKINGPOOL_H
+#define AIOURINGBLOCKINGPOOL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <taskflow/taskflow.hpp>
+
+enum class AIOUringJobPriority : uint8_t {
+    High,
+    Normal,
+    Low
+};
+
+struct AIOUringJobOptions {
+    // jobs of a category share its limits, see AIOUringBlockingPool::setCategory()
+    std::string category{};
+    AIOUringJobPriority priority{AIOUringJobPriority::Normal};
+};
+
+struct AIOUringBlockingPoolOptions {
+    // executor threads, 0 - hardware concurrency
+    size_t threads{0};
+    // jobs of all categories waiting for a thread, more are shed
+    size_t maxQueued{4096};
+};
+
+struct AIOUringBlockingCategoryLimits {
+    // jobs of the category running at once, 0 - up to the number of threads
+    size_t maxInFlight{0};
+    // jobs of the category waiting for a thread, 0 - up to the limit of the pool
+    size_t maxQueued{0};
+};
+
+struct AIOUringBlockingCategoryStats {
+    std::string category{};
+    AIOUringBlockingCategoryLimits limits{};
+    size_t inFlight{0};
+    size_t queued{0};
+    size_t queuedHighWater{0};
+    uint64_t submitted{0};
+    uint64_t completed{0};
+    // rejected on submission or pushed out of the queue by a job of a higher priority
+    uint64_t shed{0};
+    // time from the submission to the start of the job
+    uint64_t waitAvgNs{0};
+    uint64_t waitMaxNs{0};
+};
+
+struct AIOUringBlockingPoolStats {
+    size_t threads{0};
+    size_t running{0};
+    size_t queued{0};
+    size_t maxQueued{0};
+    uint64_t shed{0};
+    std::vector<AIOUringBlockingCategoryStats> categories{};
+};
+
+struct AIOUringBlockingJob {
+    std::function<void(tf::Executor *executor)> run{};
+    // called instead of run if the job is shed, on the thread which sheds it
+    std::function<void()> shed{};
+    AIOUringJobOptions options{};
+};
+
+/**
+ * Executor for blocking work shared by the rings of the process, so that N rings don't
+ * start N executors of hardware concurrency threads each. Jobs wait in the pool, not in
+ * the executor: a job starts once a thread is free and its category is below maxInFlight,
+ * higher priorities first. When the queue of the pool or of the category is full the new
+ * job is shed, unless a queued job of a lower priority can be shed instead. Thread safe.
+ */
+class AIOUringBlockingPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit AIOUringBlockingPool(AIOUringBlockingPoolOptions options = {});
+    ~AIOUringBlockingPool();
+    AIOUringBlockingPool(const AIOUringBlockingPool &) = delete;
+    AIOUringBlockingPool &operator=(const AIOUringBlockingPool &) = delete;
+
+    // pool of the process, created on first use with the options of configureShared()
+    static AIOUringBlockingPool &shared();
+    // has no effect once shared() has been called
+    static void configureShared(AIOUringBlockingPoolOptions options);
+
+    void setCategory(const std::string &category, AIOUringBlockingCategoryLimits limits);
+    // false - the job is shed right away, its shed callback has been called
+    bool submit(AIOUringBlockingJob job);
+
+    [[nodiscard]] size_t getThreadsNumber() const;
+    [[nodiscard]] AIOUringBlockingPoolStats getStats() const;
+private:
+    struct QueuedJob {
+        AIOUringBlockingJob job{};
+        Clock::time_point submittedAt{};
+    };
+
+    struct Category {
+        AIOUringBlockingCategoryLimits limits{};
+        std::array<std::deque<QueuedJob>, 3> queued{};
+        size_t queuedCount{0};
+        size_t queuedHighWater{0};
+        size_t inFlight{0};
+        uint64_t submitted{0};
+        uint64_t completed{0};
+        uint64_t shed{0};
+        uint64_t waitSumNs{0};
+        uint64_t waitMaxNs{0};
+    };
+
+    inline static std::mutex sharedMutex{};
+    inline static AIOUringBlockingPoolOptions sharedOptions{};
+    inline static std::unique_ptr<AIOUringBlockingPool> sharedPool{};
+
+    size_t threads;
+    size_t maxQueued;
+    mutable std::mutex mutex{};
+    std::map<std::string, Category> categories{};
+    size_t running{0};
+    size_t queued{0};
+    uint64_t shed{0};
+    bool stopping{false};
+    // declared last, destroyed first: waits for the running jobs which still lock the mutex
+    tf::Executor executor;
+
+    [[nodiscard]] size_t inFlightLimit(const Category &category) const;
+    [[nodiscard]] size_t queuedLimit(const Category &category) const;
+    // category nullptr - the lowest priority job of any category
+    bool shedLowerThan(AIOUringJobPriority priority, Category *category, std::vector<QueuedJob> &shedJobs);
+    void dispatch();
+    void start(Category &category, std::deque<QueuedJob> &queue);
+    void finish(Category *category);
+};
+
+#endif //AIOURINGBLOCKINGPOOL_H
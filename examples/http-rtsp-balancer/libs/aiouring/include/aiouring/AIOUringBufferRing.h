@@ -0,0 +1,101 @@
+#ifndef AIOURINGBUFFERRING_H
+#define AIOURINGBUFFERRING_H
+
+#include <liburing.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct AIOUringBufferGroupStats {
+    uint16_t groupId{0};
+    size_t bufferSize{0};
+    size_t buffers{0};
+    // buffers selected by completions and not recycled yet, including completions
+    // queued for a busy task, and the maximum of them
+    size_t inUse{0};
+    size_t highWater{0};
+    // completions which selected a buffer of the group
+    uint64_t taken{0};
+    // completions failed with -ENOBUFS because the ring was empty
+    uint64_t exhausted{0};
+    // time from the completion to the return of its buffer to the ring
+    uint64_t recycleLatencyAvgNs{0};
+    uint64_t recycleLatencyMaxNs{0};
+};
+
+class AIOUringBufferRing;
+
+/**
+ * Buffer selected by the kernel for a completion. Owns the buffer until destroyed or
+ * released, then the buffer goes back to its ring. Must be released on the ring thread.
+ */
+class AIOUringBuffer {
+public:
+    AIOUringBuffer() = default;
+    AIOUringBuffer(AIOUringBufferRing *bufferRing, uint16_t bufferId, size_t length);
+    AIOUringBuffer(AIOUringBuffer &&other) noexcept;
+    AIOUringBuffer &operator=(AIOUringBuffer &&other) noexcept;
+    AIOUringBuffer(const AIOUringBuffer &) = delete;
+    AIOUringBuffer &operator=(const AIOUringBuffer &) = delete;
+    ~AIOUringBuffer();
+
+    [[nodiscard]] char *data() const;
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] std::string_view view() const;
+    explicit operator bool() const { return bufferRing != nullptr; }
+
+    void release();
+private:
+    AIOUringBufferRing *bufferRing{nullptr};
+    uint16_t bufferId{0};
+    size_t length{0};
+};
+
+/**
+ * Provided buffer ring (IORING_REGISTER_PBUF_RING) of one buffer group: buffer-select
+ * ops of the group take their buffer from the ring on completion instead of keeping
+ * a buffer of their own while waiting for data.
+ */
+class AIOUringBufferRing {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // buffers must be a power of 2 up to 32768
+    AIOUringBufferRing(io_uring *ring, uint16_t groupId, unsigned buffers, size_t bufferSize);
+    ~AIOUringBufferRing();
+    AIOUringBufferRing(const AIOUringBufferRing &) = delete;
+    AIOUringBufferRing &operator=(const AIOUringBufferRing &) = delete;
+
+    // the kernel selected the buffer for a completion, it is in use until recycled
+    void hold(uint16_t bufferId);
+    AIOUringBuffer take(uint16_t bufferId, size_t length);
+    void recycle(uint16_t bufferId);
+    void noteExhausted();
+
+    [[nodiscard]] char *bufferData(uint16_t bufferId) const;
+    [[nodiscard]] uint16_t getGroupId() const;
+    // buffers left in the ring for the kernel to select
+    [[nodiscard]] size_t available() const;
+    [[nodiscard]] AIOUringBufferGroupStats getStats() const;
+private:
+    io_uring *ring;
+    io_uring_buf_ring *bufRing{nullptr};
+    uint16_t groupId;
+    unsigned buffers;
+    size_t bufferSize;
+    std::unique_ptr<char[]> memory{};
+    std::vector<Clock::time_point> takenAt{};
+    size_t inUse{0};
+    size_t highWater{0};
+    uint64_t taken{0};
+    uint64_t exhausted{0};
+    uint64_t recycled{0};
+    uint64_t recycleLatencySumNs{0};
+    uint64_t recycleLatencyMaxNs{0};
+};
+
+#endif //AIOURINGBUFFERRING_H
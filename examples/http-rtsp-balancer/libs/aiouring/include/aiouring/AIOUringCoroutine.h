@@ -0,0 +1,277 @@
+#ifndef AIOURINGCOROUTINE_H
+#define AIOURINGCOROUTINE_H
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <variant>
+
+#include "AIOUring.h"
+
+/**
+ * Shared by all coroutines awaited by one AIOUringCoroutineTask: the op the innermost
+ * coroutine waits for, its result and the coroutine to resume.
+ */
+struct AIOUringCoState {
+    std::optional<AIOUringOp> op{};
+    int ioResult{0};
+    std::coroutine_handle<> current{};
+    // classic task awaited through awaitTask(), polled by AIOUringCoroutineTask
+    AIOUringTask *pendingTask{nullptr};
+    void *pendingAwaiter{nullptr};
+    void (*completeTask)(void *awaiter, AIOUringTask *task, AIOUringTask::TaskFuture &future){nullptr};
+};
+
+class AIOUringOpAwaiter {
+public:
+    explicit AIOUringOpAwaiter(AIOUringOp op) : op(op) {}
+
+    [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+    template<typename P>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        state = handle.promise().state;
+        state->op = op;
+        state->current = handle;
+    }
+
+    [[nodiscard]] int await_resume() const noexcept { return state->ioResult; }
+private:
+    AIOUringOp op;
+    AIOUringCoState *state{nullptr};
+};
+
+template<typename T>
+class AIOUringCoResult {
+public:
+    void return_value(T value) {
+        result.template emplace<1>(std::move(value));
+    }
+    void unhandled_exception() {
+        result.template emplace<2>(std::current_exception());
+    }
+    T takeResult() {
+        if(auto exception = std::get_if<2>(&result)) {
+            std::rethrow_exception(*exception);
+        }
+        return std::move(*std::get_if<1>(&result));
+    }
+private:
+    std::variant<std::monostate, T, std::exception_ptr> result{};
+};
+
+template<>
+class AIOUringCoResult<std::monostate> {
+public:
+    void return_void() {}
+    void unhandled_exception() {
+        exception = std::current_exception();
+    }
+    std::monostate takeResult() {
+        if(exception) {
+            std::rethrow_exception(exception);
+        }
+        return {};
+    }
+private:
+    std::exception_ptr exception{};
+};
+
+/**
+ * Coroutine of a ring. Locals live in the coroutine frame, which comes from the frame
+ * allocator of the ring. co_await of an AIOUringOp suspends until its CQE and returns
+ * io_result, co_await of another AIOUringCo transfers control to it directly and returns
+ * its co_return value or rethrows its exception. It starts suspended and is driven by
+ * AIOUringCoroutineTask.
+ */
+template<typename T = std::monostate>
+class [[nodiscard]] AIOUringCo {
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct FinalAwaiter {
+        [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+            auto continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type : AIOUringCoResult<T> {
+        AIOUringCoState *state{nullptr};
+        std::coroutine_handle<> continuation{};
+
+        AIOUringCo get_return_object() { return AIOUringCo{Handle::from_promise(*this)}; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        AIOUringOpAwaiter await_transform(AIOUringOp op) { return AIOUringOpAwaiter{op}; }
+
+        template<typename A>
+        A &&await_transform(A &&awaitable) { return std::forward<A>(awaitable); }
+
+        static void *operator new(size_t size) { return AIOUringFrameAllocator::allocate(size); }
+        static void operator delete(void *frame) noexcept { AIOUringFrameAllocator::deallocate(frame); }
+    };
+
+    AIOUringCo(AIOUringCo &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    AIOUringCo &operator=(AIOUringCo &&other) noexcept {
+        if(this != &other) {
+            destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    AIOUringCo(const AIOUringCo &) = delete;
+    AIOUringCo &operator=(const AIOUringCo &) = delete;
+    ~AIOUringCo() { destroy(); }
+
+    [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+    template<typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) noexcept {
+        handle.promise().continuation = parent;
+        handle.promise().state = parent.promise().state;
+        return handle;
+    }
+
+    T await_resume() { return handle.promise().takeResult(); }
+
+    void start(AIOUringCoState *state) { handle.promise().state = state; }
+    [[nodiscard]] std::coroutine_handle<> getHandle() const { return handle; }
+    T takeResult() { return handle.promise().takeResult(); }
+private:
+    Handle handle{};
+
+    explicit AIOUringCo(Handle handle) : handle(handle) {}
+
+    void destroy() {
+        if(handle) {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+};
+
+/**
+ * Awaits a classic task from a coroutine, the same way AWAIT_TASK does. Results in the
+ * outcome of the task.
+ */
+template<typename T>
+class AIOUringTaskAwaiter {
+public:
+    AIOUringTaskAwaiter(AIOUring *aioUring, T *task) : aioUring(aioUring), task(task) {}
+    AIOUringTaskAwaiter(AIOUringTaskAwaiter &&other) noexcept
+            : aioUring(other.aioUring), task(std::exchange(other.task, nullptr)) {}
+    AIOUringTaskAwaiter(const AIOUringTaskAwaiter &) = delete;
+    AIOUringTaskAwaiter &operator=(const AIOUringTaskAwaiter &) = delete;
+    ~AIOUringTaskAwaiter() {
+        if(task != nullptr) {
+            aioUring->freeTask(task);
+        }
+    }
+
+    [[nodiscard]] bool await_ready() const noexcept { return false; }
+
+    template<typename P>
+    void await_suspend(std::coroutine_handle<P> handle) noexcept {
+        AIOUringCoState *state = handle.promise().state;
+
+        task->bindOutcome(&outcome);
+        state->current = handle;
+        state->pendingTask = task;
+        state->pendingAwaiter = this;
+        state->completeTask = &AIOUringTaskAwaiter::complete;
+    }
+
+    AIOUringTaskOutcome<typename T::TResult> await_resume() { return std::move(outcome); }
+private:
+    AIOUring *aioUring;
+    T *task;
+    AIOUringTaskOutcome<typename T::TResult> outcome{};
+
+    static void complete(void *awaiter, AIOUringTask *task, AIOUringTask::TaskFuture &future) {
+        auto self = static_cast<AIOUringTaskAwaiter *>(awaiter);
+
+        if(std::get<1>(future).has_value()) {
+            self->outcome.setError(std::move(*std::get<1>(future)));
+        }
+
+        self->aioUring->freeTask(static_cast<T *>(task));
+        self->task = nullptr;
+    }
+};
+
+template<typename T, typename... Args>
+requires Derived<T, AIOUringTask> && IsFinal<T> && AIOUringTaskTrait<T>
+AIOUringTaskAwaiter<T> awaitTask(AIOUring *aioUring, Args&&... args) {
+    return AIOUringTaskAwaiter<T>{aioUring, aioUring->newTask<T>(std::forward<Args>(args)...)};
+}
+
+/**
+ * Runs a top level coroutine as an ordinary task of the ring: ops of the coroutine and
+ * of everything it awaits are returned from poll(), so they go through the same CQE loop,
+ * timers, cancellation and AWAIT_TASK as classic tasks.
+ */
+template<typename T = std::monostate>
+class AIOUringCoroutineTask final : public AIOUringTask {
+public:
+    using TResult = T;
+
+    explicit AIOUringCoroutineTask(AIOUringCo<T> coroutine) : coroutine(std::move(coroutine)) {}
+
+    TaskFuture poll(int io_result) override {
+        std::coroutine_handle<> next = state.current;
+
+        if(!next) {
+            coroutine.start(&state);
+            next = coroutine.getHandle();
+        }
+
+        state.ioResult = io_result;
+
+        while(true) {
+            if(state.pendingTask != nullptr) {
+                TaskFuture future = state.pendingTask->poll(state.ioResult);
+
+                if(std::get<0>(future).has_value()) {
+                    return future;
+                }
+
+                state.completeTask(state.pendingAwaiter, std::exchange(state.pendingTask, nullptr), future);
+            }
+
+            state.op.reset();
+            next.resume();
+
+            if(state.op.has_value()) {
+                return futureOp(*state.op);
+            }
+
+            if(state.pendingTask == nullptr) {
+                break;
+            }
+
+            this->attachChild(state.pendingTask);
+            next = state.current;
+        }
+
+        try {
+            return futureValue<TResult>(coroutine.takeResult());
+        } catch (std::exception &e) {
+            return futureError(0, e.what());
+        } catch (...) {
+            // a coroutine may throw anything, the ring must not go down with it
+            return futureError(0, "unknown exception");
+        }
+    }
+private:
+    AIOUringCoState state{};
+    AIOUringCo<T> coroutine;
+};
+
+#endif //AIOURINGCOROUTINE_H
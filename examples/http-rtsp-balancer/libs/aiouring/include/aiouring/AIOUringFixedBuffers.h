@@ -0,0 +1,79 @@
+#ifndef AIOURINGFIXEDBUFFERS_H
+#define AIOURINGFIXEDBUFFERS_H
+
+#include <liburing.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct AIOUringFixedBufferStats {
+    size_t bufferSize{0};
+    size_t buffers{0};
+    // buffers leased by tasks right now and the maximum of them
+    size_t inUse{0};
+    size_t highWater{0};
+    uint64_t leased{0};
+    // leases refused because every buffer was taken
+    uint64_t exhausted{0};
+};
+
+class AIOUringFixedBuffers;
+
+/**
+ * Registered buffer leased by a task: ReadFixed/WriteFixed/SendZCFixed with index() skip
+ * pinning its pages on every op. Goes back to the pool when destroyed or released,
+ * must be released on the ring thread.
+ */
+class AIOUringFixedBuffer {
+public:
+    AIOUringFixedBuffer() = default;
+    AIOUringFixedBuffer(AIOUringFixedBuffers *buffers, unsigned bufferIndex);
+    AIOUringFixedBuffer(AIOUringFixedBuffer &&other) noexcept;
+    AIOUringFixedBuffer &operator=(AIOUringFixedBuffer &&other) noexcept;
+    AIOUringFixedBuffer(const AIOUringFixedBuffer &) = delete;
+    AIOUringFixedBuffer &operator=(const AIOUringFixedBuffer &) = delete;
+    ~AIOUringFixedBuffer();
+
+    [[nodiscard]] char *data() const;
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] unsigned index() const { return bufferIndex; }
+    explicit operator bool() const { return buffers != nullptr; }
+
+    void release();
+private:
+    AIOUringFixedBuffers *buffers{nullptr};
+    unsigned bufferIndex{0};
+};
+
+/**
+ * Buffers registered with IORING_REGISTER_BUFFERS, leased whole by tasks which keep
+ * streaming through them.
+ */
+class AIOUringFixedBuffers {
+public:
+    AIOUringFixedBuffers(io_uring *ring, unsigned buffers, size_t bufferSize);
+    ~AIOUringFixedBuffers();
+    AIOUringFixedBuffers(const AIOUringFixedBuffers &) = delete;
+    AIOUringFixedBuffers &operator=(const AIOUringFixedBuffers &) = delete;
+
+    // empty if every buffer is leased
+    AIOUringFixedBuffer lease();
+    void recycle(unsigned bufferIndex);
+
+    [[nodiscard]] char *bufferData(unsigned bufferIndex) const;
+    [[nodiscard]] size_t getBufferSize() const;
+    [[nodiscard]] AIOUringFixedBufferStats getStats() const;
+private:
+    io_uring *ring;
+    unsigned buffers;
+    size_t bufferSize;
+    std::unique_ptr<char[]> memory{};
+    std::vector<unsigned> freeBuffers{};
+    uint64_t leased{0};
+    uint64_t exhausted{0};
+    size_t highWater{0};
+};
+
+#endif //AIOURINGFIXEDBUFFERS_H
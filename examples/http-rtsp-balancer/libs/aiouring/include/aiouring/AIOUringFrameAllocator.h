@@ -0,0 +1,44 @@
+#ifndef AIOURINGFRAMEALLOCATOR_H
+#define AIOURINGFRAMEALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "AIOUringTaskPool.h"
+
+/**
+ * Allocator of coroutine frames for the ring running on the current thread. Frames are
+ * rounded up to 64-byte size classes, each class is served by its own slab pool; frames
+ * allocated outside of a ring thread or larger than 8 KiB go to the global allocator.
+ */
+class AIOUringFrameAllocator {
+public:
+    AIOUringFrameAllocator() = default;
+    ~AIOUringFrameAllocator();
+    AIOUringFrameAllocator(const AIOUringFrameAllocator &) = delete;
+    AIOUringFrameAllocator &operator=(const AIOUringFrameAllocator &) = delete;
+
+    static void *allocate(size_t size);
+    static void deallocate(void *frame) noexcept;
+
+    static void setCurrent(AIOUringFrameAllocator *allocator);
+
+    [[nodiscard]] std::vector<AIOUringTaskPoolStats> getStats() const;
+private:
+    // precedes every frame, keeps the pool to return the frame to
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) FrameHeader {
+        AIOUringTaskPool *pool;
+    };
+
+    static constexpr size_t sizeClass = 64;
+    static constexpr size_t maxPooledSize = 8192;
+
+    inline static thread_local AIOUringFrameAllocator *current{nullptr};
+
+    std::vector<std::unique_ptr<AIOUringTaskPool>> pools{};
+
+    AIOUringTaskPool &getPool(size_t size);
+};
+
+#endif //AIOURINGFRAMEALLOCATOR_H
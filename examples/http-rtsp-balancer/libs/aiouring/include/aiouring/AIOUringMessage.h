@@ -0,0 +1,55 @@
+#ifndef AIOURINGMESSAGE_H
+#define AIOURINGMESSAGE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "AIOUringMpscQueue.h"
+
+class AIOUring;
+
+/**
+ * Message from one ring to another, see AIOUring::sendTo(). The receiving ring passes it to
+ * the handler of its type on the ring thread.
+ */
+struct AIOUringMessage {
+    // types with this bit are used by the tasks of the library, e.g. accepted connections
+    static constexpr uint32_t reservedTypes = 0x80000000u;
+
+    uint32_t type{0};
+    uint64_t value{0};
+    // moves to the receiver: a plain fd as is, a direct fd of the sender arrives as a direct
+    // fd of the receiver; closed if the message has no handler
+    int fd{-1};
+    std::shared_ptr<void> payload{};
+    // instance id of the sending ring, set by sendTo()
+    int from{-1};
+};
+
+using AIOUringMessageHandler = std::function<void(AIOUring *aioUring, AIOUringMessage message)>;
+
+struct AIOUringMessageNode {
+    AIOUringMessageNode *next{nullptr};
+    // receiver, kept for the fallback to its queue if IORING_OP_MSG_RING fails
+    AIOUring *target{nullptr};
+    AIOUringMessage message{};
+};
+
+using AIOUringMessageQueue = AIOUringMpscQueue<AIOUringMessageNode>;
+
+struct AIOUringMessageStats {
+    // sent through IORING_OP_MSG_RING and through the queue of the receiver
+    uint64_t sentRing{0};
+    uint64_t sentQueue{0};
+    // direct fds passed with IORING_MSG_SEND_FD
+    uint64_t sentFds{0};
+    // IORING_OP_MSG_RING failures, the message went through the queue instead
+    uint64_t ringFailures{0};
+    uint64_t receivedRing{0};
+    uint64_t receivedQueue{0};
+    // messages without a handler, or direct fds which couldn't be passed
+    uint64_t dropped{0};
+};
+
+#endif //AIOURINGMESSAGE_H
@@ -6,22 +6,174 @@
 #define AIOURINGOP_H
 
 #include <liburing.h>
-#include <functional>
+#include <chrono>
+#include <fcntl.h>
 #include <optional>
+#include <type_traits>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
+/**
+ * Plain descriptor of an io_uring operation, AIOUring turns it into an sqe directly.
+ * Operations which are not known to the framework can be described by Custom(),
+ * the prepare function receives the sqe and the descriptor itself.
+ * withTimeout() links an IORING_OP_LINK_TIMEOUT to the operation, on expiry the
+ * operation completes with -ECANCELED.
+ * Multishot ops keep posting CQEs until a CQE without IORING_CQE_F_MORE: a task returns
+ * the same op again to receive the next one, AIOUring keeps the completions which come
+ * while the task is busy. A top level task has at most one multishot op armed.
+ * SendZC completes with the number of bytes sent, the kernel may still read the buffer until
+ * its notification CQE: the buffer is reused after ZeroCopyFlush() or handed to
+ * AIOUring::releaseAfterZeroCopy(). Notifications of a socket come in the order of its sends.
+ * An fd made by directFd() refers to the registered file table of the ring: the sqe gets
+ * IOSQE_FIXED_FILE and Close() of it becomes a direct close, which frees the slot.
+ */
 struct AIOUringOp {
-    std::optional<std::function<void(io_uring *, __u64)>> submit{std::nullopt};
-    bool shutdown{false};
-    int shutdownCode{0};
+    using Prepare = void (*)(io_uring_sqe *sqe, const AIOUringOp &op);
+
+    enum class Kind : __u8 {
+        Empty,
+        ShutdownUring,
+        Yield,
+        Park,
+        LongTask,
+        Deadline,
+        Nop,
+        Read,
+        Write,
+        ReadFixed,
+        WriteFixed,
+        Readv,
+        Writev,
+        Recv,
+        SendMsg,
+        RecvMsg,
+        RecvMultishot,
+        SendZC,
+        SendZCFixed,
+        ZeroCopyFlush,
+        Splice,
+        Poll,
+        Accept,
+        AcceptMultishot,
+        Close,
+        Connect,
+        Shutdown,
+        Timeout,
+        InstallFile,
+        Custom
+    };
+
+    Kind kind{Kind::Empty};
+    int fd{-1};
+    // buffer, iovec array, msghdr or socket address, parked task for Park
+    void *addr{nullptr};
+    // accept: pointer to socklen_t
+    void *addr2{nullptr};
+    // buffer size, number of iovecs, socket address length, poll mask or shutdown how;
+    // accept: IORING_FILE_INDEX_ALLOC to install the socket into the file table
+    __u32 len{0};
+    // splice: the fd to read from
+    __u64 offset{0};
+    // op specific flags, exit code for ShutdownUring
+    int flags{0};
+    Prepare prepare{nullptr};
+    // Timeout duration or linked timeout of the op, 0 - no timeout;
+    // steady clock time since epoch for Deadline
+    __u64 timeoutNs{0};
+    // buffer group the kernel selects the buffer from, -1 - the op has its own buffer
+    int bufferGroup{-1};
+    // registered buffer of ReadFixed, WriteFixed and SendZCFixed
+    unsigned bufferIndex{0};
+
+    static constexpr int directFdFlag = 1 << 30;
+
+    [[nodiscard]] static constexpr int directFd(unsigned index) {
+        return static_cast<int>(index) | directFdFlag;
+    }
+    [[nodiscard]] static constexpr bool isDirectFd(int fd) {
+        return fd >= 0 && (fd & directFdFlag) != 0;
+    }
+    [[nodiscard]] static constexpr unsigned directIndex(int fd) {
+        return static_cast<unsigned>(fd & ~directFdFlag);
+    }
+
+    [[nodiscard]] bool isShutdownUring() const { return kind == Kind::ShutdownUring; }
+    [[nodiscard]] bool isYield() const { return kind == Kind::Yield; }
+    [[nodiscard]] bool isPark() const { return kind == Kind::Park; }
+    [[nodiscard]] bool isLongTask() const { return kind == Kind::LongTask; }
+    [[nodiscard]] bool isDeadline() const { return kind == Kind::Deadline; }
+    [[nodiscard]] int shutdownCode() const { return flags; }
+    [[nodiscard]] bool isBufferSelect() const { return bufferGroup >= 0; }
+    [[nodiscard]] bool isZeroCopyFlush() const { return kind == Kind::ZeroCopyFlush; }
+    // a positive result is the number of bytes moved
+    [[nodiscard]] static constexpr bool movesData(Kind kind) {
+        return kind >= Kind::Read && kind <= Kind::Splice && kind != Kind::ZeroCopyFlush;
+    }
+    [[nodiscard]] bool isMultishot() const {
+        return kind == Kind::AcceptMultishot || kind == Kind::RecvMultishot;
+    }
+    [[nodiscard]] bool hasLinkedTimeout() const {
+        return timeoutNs > 0 && kind != Kind::Timeout && kind != Kind::Deadline;
+    }
+    [[nodiscard]] std::chrono::steady_clock::time_point deadline() const {
+        return std::chrono::steady_clock::time_point{std::chrono::nanoseconds{timeoutNs}};
+    }
+
+    AIOUringOp withTimeout(std::chrono::nanoseconds timeout) const;
+
+    void prepareSqe(io_uring_sqe *sqe) const;
+
     static AIOUringOp ShutdownUring(int code = 0);
+    static AIOUringOp Yield();
+    static AIOUringOp Park(void *task);
+    // waits for the job passed to AIOUring::awaitLongTask(), never reaches the kernel
+    static AIOUringOp LongTask();
+    static AIOUringOp Deadline(std::chrono::steady_clock::time_point deadline);
     static AIOUringOp Nop();
     static AIOUringOp Read(int fd, void *buf, size_t buf_size, __u64 offset = 0);
     static AIOUringOp Write(int fd, void *buf, size_t buf_size, __u64 offset = 0);
+    // buf lies in the registered buffer bufIndex, see AIOUring::leaseFixedBuffer()
+    static AIOUringOp ReadFixed(int fd, void *buf, size_t buf_size, unsigned bufIndex, __u64 offset = 0);
+    static AIOUringOp WriteFixed(int fd, const void *buf, size_t buf_size, unsigned bufIndex, __u64 offset = 0);
+    static AIOUringOp Recv(int fd, void *buf, size_t buf_size, int flags = 0);
+    // iovecs and the buffers they point to must live until the completion
+    static AIOUringOp Readv(int fd, const struct iovec *iovecs, unsigned count, __u64 offset = 0);
+    static AIOUringOp Writev(int fd, const struct iovec *iovecs, unsigned count, __u64 offset = 0);
+    static AIOUringOp SendMsg(int fd, const struct msghdr *msg, int flags = 0);
+    static AIOUringOp RecvMsg(int fd, struct msghdr *msg, int flags = 0);
+    // the kernel selects the buffer from bufferGroup on completion, see AIOUring::takeBuffer(),
+    // buf_size 0 - up to the buffer size; bufferGroup < 0 is a plain Read/Recv into buf
+    static AIOUringOp ReadSelect(int fd, int bufferGroup, void *buf = nullptr, size_t buf_size = 0);
+    static AIOUringOp RecvSelect(int fd, int bufferGroup, void *buf = nullptr, size_t buf_size = 0, int flags = 0);
+    // each CQE carries a chunk of data in a buffer of bufferGroup, until the peer closes
+    static AIOUringOp RecvMultishot(int fd, int bufferGroup, int flags = 0);
+    static AIOUringOp SendZC(int fd, const void *buf, size_t buf_size, int flags = 0);
+    // buf lies in the registered buffer bufIndex
+    static AIOUringOp SendZCFixed(int fd, const void *buf, size_t buf_size, unsigned bufIndex, int flags = 0);
+    // waits until at most keepPending of the latest SendZC of the task are without a notification
+    static AIOUringOp ZeroCopyFlush(unsigned keepPending = 0);
+    // moves up to len bytes between fds one of which is a pipe, without copying them to userspace
+    static AIOUringOp Splice(int fdIn, int fdOut, size_t len, unsigned flags = SPLICE_F_MOVE);
+    // results in the ready events of mask
+    static AIOUringOp Poll(int fd, unsigned mask);
     static AIOUringOp Accept(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags = 0);
+    // results in the slot index in the file table, see directFd()
+    static AIOUringOp AcceptDirect(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags = 0);
+    // each CQE carries an accepted socket, the peer address is left to getpeername()
+    static AIOUringOp AcceptMultishot(int fd, int flags = 0);
+    static AIOUringOp AcceptMultishotDirect(int fd, int flags = 0);
     static AIOUringOp Close(int fd);
     static AIOUringOp Connect(int fd, const struct sockaddr *addr, socklen_t addrlen);
     static AIOUringOp Shutdown(int fd, int how = SHUT_RDWR);
+    static AIOUringOp Timeout(std::chrono::nanoseconds timeout);
+    // installs *fd into a free slot of the file table and overwrites it with the slot
+    // index, results in 1 on success; the original fd stays open
+    static AIOUringOp InstallFile(int *fd);
+    static AIOUringOp Custom(Prepare prepare, int fd = -1, void *addr = nullptr,
+                             __u32 len = 0, __u64 offset = 0, int flags = 0);
 };
 
+static_assert(std::is_trivially_copyable_v<AIOUringOp>, "AIOUringOp must stay a plain descriptor");
+
 #endif //AIOURINGOP_H
@@ -0,0 +1,55 @@
+#ifndef AIOURINGPIPEPOOL_H
+#define AIOURINGPIPEPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+struct AIOUringPipe {
+    int readFd{-1};
+    int writeFd{-1};
+};
+
+struct AIOUringPipePoolStats {
+    // pipes waiting in the pool and the pool limit
+    size_t idle{0};
+    size_t maxIdle{0};
+    size_t inUse{0};
+    uint64_t created{0};
+    uint64_t reused{0};
+    // pipes closed on release because data was left in them or the pool was full
+    uint64_t discarded{0};
+};
+
+/**
+ * Pipes of one ring for splice relays: a relay takes a pipe for its lifetime and returns it,
+ * an empty pipe goes back to the pool instead of being closed. Not thread safe.
+ */
+class AIOUringPipePool {
+public:
+    // pipeSize 0 - keep the default capacity of the pipe
+    AIOUringPipePool(size_t maxIdle, size_t pipeSize);
+    ~AIOUringPipePool();
+    AIOUringPipePool(const AIOUringPipePool &) = delete;
+    AIOUringPipePool &operator=(const AIOUringPipePool &) = delete;
+
+    // std::nullopt with errno set if a new pipe couldn't be created
+    std::optional<AIOUringPipe> acquire();
+    // a pipe which may still hold data is closed, it can't serve the next relay
+    void release(AIOUringPipe pipe, bool drained);
+
+    [[nodiscard]] AIOUringPipePoolStats getStats() const;
+private:
+    size_t maxIdle;
+    size_t pipeSize;
+    std::vector<AIOUringPipe> idle{};
+    size_t inUse{0};
+    uint64_t created{0};
+    uint64_t reused{0};
+    uint64_t discarded{0};
+
+    static void close(AIOUringPipe pipe);
+};
+
+#endif //AIOURINGPIPEPOOL_H
@@ -7,7 +7,7 @@
 
 #include "aiouring/AIOUring.h"
 #include <aioutils/uhttp.hpp>
-#include "TCPWrite.hpp"
+#include "TCPWritev.hpp"
 
 using namespace aioutils;
 
@@ -25,18 +25,20 @@ public:
         httpResponse = uhttp::HttpResponse{uhttp::HttpResponse404Text};
         httpResponse.parse();
 
-        responseData = httpResponse.toRaw();
+        responseHeaders = httpResponse.headersToRaw();
 
-        AWAIT_TASKNL(tcpWrite, clientSocket, responseData.data(), responseData.size());
+        AWAIT_TASKNL(tcpWritev, clientSocket, std::vector<iovec>{
+                iovec{responseHeaders.data(), responseHeaders.size()},
+                iovec{const_cast<char *>(httpResponse.getContent().data()), httpResponse.getContent().size()}});
 
         return TASK_RESULT_NONE();
     }
 private:
     AIOUring *aioUring{nullptr};
-    TASK_DEF(TCPWrite, tcpWrite);
+    TASK_DEF(TCPWritev, tcpWritev);
     int clientSocket{-1};
     uhttp::HttpResponse httpResponse{};
-    uhttp::HttpResponse::DataType responseData{};
+    std::string responseHeaders{};
 };
 
 #pragma clang diagnostic pop
@@ -37,19 +37,19 @@ public:
         host[0].ar_request = hint;
 
         sig.sigev_notify = SIGEV_THREAD;
-        sig.sigev_value.sival_int = *this->getTaskfd().lock();
+        sig.sigev_value.sival_int = this->getEventfd();
         sig.sigev_notify_function = &ResolveHostTask::NotifyTask;
 
         getaddrinfo_a(GAI_NOWAIT, &host, 1, &sig);
 
-        AWAIT_EVENT(*this->getTaskfd().lock());
+        AWAIT_EVENT(this->getEventfd());
 
         int gaiRet = gai_error(host);
 
         if(gaiRet != 0)
         {
-            return TASK_ERROR(fmt::format("GAI error, code {}: {}, {}",
-                                          gaiRet, gai_strerror(gaiRet), host->ar_name));
+            return TASK_ERROR("GAI error, code {}: {}, {}",
+                              gaiRet, gai_strerror(gaiRet), host->ar_name);
         }
 
         for(addrinfo *rp = host->ar_result; rp != nullptr; rp = rp->ai_next)
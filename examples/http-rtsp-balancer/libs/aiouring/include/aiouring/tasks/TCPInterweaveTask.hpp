@@ -6,21 +6,36 @@
 #define AIOURING_TCPINTERWEAVETASK_HPP
 
 #include "TCPSinkTask.hpp"
+#include "TCPSpliceSinkTask.hpp"
 
 class TCPInterweaveTask final : public AIOUringTask {
 public:
-    explicit TCPInterweaveTask(AIOUring *aioUring, int tcpFrom, int tcpTo)
-            : aioUring(aioUring), tcpFrom(tcpFrom), tcpTo(tcpTo) {}
+    // splice - relay through pipes with splice, if the kernel supports it; not measured
+    // against the buffered relay yet, so off unless asked for
+    explicit TCPInterweaveTask(AIOUring *aioUring, int tcpFrom, int tcpTo, bool splice = false)
+            : aioUring(aioUring), tcpFrom(tcpFrom), tcpTo(tcpTo),
+              splice(splice && aioUring->isOpSupported(IORING_OP_SPLICE)) {}
     TaskFuture poll(int io_result) override {
         ASYNC_IO;
 
-        aioUring->pushTask(aioUring->newTask<TCPSinkTask<>>(
-                aioUring, tcpFrom, tcpTo, this->getTaskfd()));
-        aioUring->pushTask(aioUring->newTask<TCPSinkTask<>>(
-                aioUring, tcpTo, tcpFrom, this->getTaskfd()));
+        if(splice) {
+            fromSink = pushSink(aioUring->newTask<TCPSpliceSinkTask<>>(
+                    aioUring, tcpFrom, tcpTo, aioUring->getTaskRef(this)));
+            toSink = pushSink(aioUring->newTask<TCPSpliceSinkTask<>>(
+                    aioUring, tcpTo, tcpFrom, aioUring->getTaskRef(this)));
+        } else {
+            fromSink = pushSink(aioUring->newTask<TCPSinkTask<>>(
+                    aioUring, tcpFrom, tcpTo, aioUring->getTaskRef(this)));
+            toSink = pushSink(aioUring->newTask<TCPSinkTask<>>(
+                    aioUring, tcpTo, tcpFrom, aioUring->getTaskRef(this)));
+        }
 
         //wait at least one task to make work done
-        AWAIT_EVENT(*this->getTaskfd().lock());
+        AWAIT_WAKE();
+
+        // tear down the other direction right away, the finished sink is already freed
+        aioUring->cancelTask(fromSink);
+        aioUring->cancelTask(toSink);
 
         return TASK_RESULT_NONE();
     }
@@ -28,6 +43,15 @@ private:
     AIOUring *aioUring{};
     int tcpFrom{};
     int tcpTo{};
+    bool splice{false};
+    AIOUringTaskRef fromSink{};
+    AIOUringTaskRef toSink{};
+
+    template<typename T>
+    AIOUringTaskRef pushSink(T *sink) {
+        aioUring->pushTask(sink);
+        return aioUring->getTaskRef(sink);
+    }
 };
 
 #endif //AIOURING_TCPINTERWEAVETASK_HPP
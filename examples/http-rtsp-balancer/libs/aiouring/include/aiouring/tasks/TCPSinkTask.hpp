@@ -8,7 +8,9 @@
 #include "aiouring/AIOUring.h"
 #include <aioutils/uexcept.h>
 #include <aioutils/unet.h>
+#include <cstring>
 #include <arpa/inet.h>
+#include <array>
 #include <utility>
 
 using namespace aioutils;
@@ -17,17 +19,54 @@ template<int BufferSize = 1048576>
 class TCPSinkTask final : public AIOUringTask {
 public:
     explicit TCPSinkTask(AIOUring *aioUring, int tcpFrom, int tcpTo,
-                         std::optional<std::weak_ptr<int>> notifyfd = std::nullopt)
+                         std::optional<AIOUringTaskRef> notifyTask = std::nullopt)
             : aioUring(aioUring), tcpFrom(tcpFrom),
-              tcpTo(tcpTo), notifyfd(std::move(notifyfd)) {}
+              tcpTo(tcpTo), notifyTask(notifyTask) {}
 
     TaskFuture poll(int io_result) override {
         ASYNC_IO;
 
-        AWAIT_OP(Read, readFrom, tcpFrom, buffer.data(), buffer.size());
+        // zero-copy sends of registered buffers don't pin their pages on every send; a chunk is read
+        // into one buffer while the sends of the other one wait for their notifications, the peer acks
+        if(aioUring->getZeroCopyThreshold() > 0) {
+            fixedBuffers[0] = aioUring->leaseFixedBuffer();
+            fixedBuffers[1] = aioUring->leaseFixedBuffer();
+
+            if(!fixedBuffers[1]) {
+                // a single buffer would wait for the ack of every chunk
+                fixedBuffers[0].release();
+            }
+        }
+
+        fixed = static_cast<bool>(fixedBuffers[1]);
+        slices = fixed ? 2 : 1;
+
+        // otherwise chunks stream in through multishot recv into buffers of the ring, no buffer of its own
+        multishotRecv = !fixed && aioUring->supportsMultishotRecv() && aioUring->getReadBufferGroup() >= 0;
+
+        if(!multishotRecv && !fixed) {
+            buffer.resize(BufferSize);
+            // halves, for the same reason as the registered buffers
+            slices = aioUring->getZeroCopyThreshold() > 0 ? 2 : 1;
+        }
+
+        ASYNC_LOOP(readChunk);
+
+        if(fixed) {
+            AWAIT_OP(ReadFixed, readFixedFrom, tcpFrom, sliceData(), sliceSize(), fixedBuffers[slice].index());
+        } else if(multishotRecv) {
+            AWAIT_OP(RecvMultishot, recvFrom, tcpFrom, aioUring->getReadBufferGroup());
+        } else {
+            AWAIT_OP(Read, readFrom, tcpFrom, sliceData(), sliceSize());
+        }
+
+        if(io_result == -ECANCELED) {
+            // the other direction is done
+            return TASK_RESULT_NONE();
+        }
 
         if(io_result < 0) {
-            return TASK_ERROR(fmt::format("Error on tcp read: {}", uexcept::errnoStr(-io_result)));
+            return TASK_ERROR_WITH_CODE(io_result, "Error on tcp read: {}", strerror(-io_result));
         }
 
         if(io_result == 0) {
@@ -35,42 +74,105 @@ public:
             return TASK_RESULT_NONE();
         }
 
+        chunk = aioUring->takeBuffer(io_result);
+        chunkData = chunk ? chunk.data() : sliceData();
         bytesToWrite = io_result;
         offset = 0;
+        chunkZeroCopySends = 0;
+
+        ASYNC_LOOP(writeChunk);
+
+        // large chunks go without copying them into the socket buffer
+        zeroCopy = aioUring->getZeroCopyThreshold() > 0 &&
+                   static_cast<size_t>(bytesToWrite) >= aioUring->getZeroCopyThreshold();
+
+        if(zeroCopy && fixed) {
+            AWAIT_OP(SendZCFixed, sendFixedTo, tcpTo, chunkData + offset, bytesToWrite, fixedBuffers[slice].index());
+        } else if(zeroCopy) {
+            AWAIT_OP(SendZC, sendTo, tcpTo, chunkData + offset, bytesToWrite);
+        } else if(fixed) {
+            AWAIT_OP(WriteFixed, writeFixedTo, tcpTo, chunkData + offset, bytesToWrite, fixedBuffers[slice].index());
+        } else {
+            AWAIT_OP(Write, writeTo, tcpTo, chunkData + offset, bytesToWrite);
+        }
 
-        AWAIT_OP(Write, writeTo, tcpTo, buffer.data() + offset, bytesToWrite);
+        if(io_result == -ECANCELED) {
+            // the other direction is done
+            return TASK_RESULT_NONE();
+        }
 
         if(io_result < 0) {
-            return TASK_ERROR(fmt::format("Error on tcp write: {}", uexcept::errnoStr(-io_result)));
+            return TASK_ERROR_WITH_CODE(io_result, "Error on tcp write: {}", strerror(-io_result));
+        }
+
+        if(zeroCopy) {
+            ++chunkZeroCopySends;
         }
 
         if(io_result < bytesToWrite) {
             bytesToWrite -= io_result;
             offset += io_result;
-            ASYNC_CONTINUE_OP(writeTo);
+            AWAIT_LOOP(writeChunk);
+        }
+
+        if(chunkZeroCopySends > 0) {
+            if(chunk) {
+                // the kernel may still read the chunk, it goes back to the ring on the notification
+                aioUring->releaseAfterZeroCopy(this, std::move(chunk));
+            } else {
+                // the next chunk goes into the other slice once the sends of its previous chunk are
+                // notified, the sends of this chunk may stay pending
+                slice = (slice + 1) % slices;
+
+                AWAIT_OP(ZeroCopyFlush, flushSends, slices > 1 ? chunkZeroCopySends : 0);
+
+                if(io_result == -ECANCELED) {
+                    return TASK_RESULT_NONE();
+                }
+            }
         }
 
-        ASYNC_CONTINUE_OP(readFrom);
+        chunk.release();
+
+        AWAIT_LOOP(readChunk);
 
         return TASK_RESULT_NONE();
     }
 
     TaskFuture finally(int io_result) override {
-        if(notifyfd.has_value()) {
-            if(auto eventFd = notifyfd->lock()) {
-                EVENT_NOTIFY(*eventFd);
-            }
+        if(notifyTask.has_value()) {
+            aioUring->wake(*notifyTask);
         }
         return TASK_RESULT_NONE();
     }
 private:
+    [[nodiscard]] char *sliceData() {
+        return fixed ? fixedBuffers[slice].data() : buffer.data() + slice * sliceSize();
+    }
+
+    [[nodiscard]] size_t sliceSize() const {
+        return fixed ? fixedBuffers[slice].size() : buffer.size() / slices;
+    }
+
     AIOUring *aioUring{};
     int tcpFrom{};
     int tcpTo{};
-    std::optional<std::weak_ptr<int>> notifyfd{};
-    std::array<char, BufferSize> buffer{};
+    std::optional<AIOUringTaskRef> notifyTask{};
+    bool multishotRecv{false};
+    // registered buffers leased from the ring for the whole stream, both or none
+    std::array<AIOUringFixedBuffer, 2> fixedBuffers{};
+    bool fixed{false};
+    // allocated only without registered buffers and multishot recv
+    std::vector<char> buffer{};
+    // the registered buffer or the half of buffer the next chunk is read into
+    size_t slice{0};
+    size_t slices{1};
+    AIOUringBuffer chunk{};
+    char *chunkData{nullptr};
     int bytesToWrite{};
     int offset{};
+    bool zeroCopy{false};
+    unsigned chunkZeroCopySends{0};
 };
 
 #endif //AIOURING_TCPSINKTASK_HPP
@@ -270,7 +270,8 @@ namespace uhttp {
             headers[header.getType()] = header;
         }
 
-        DataType toRaw()
+        // status line and headers up to the empty line, the content is left to getContent()
+        std::string headersToRaw()
         {
             std::ostringstream oss;
 
@@ -285,16 +286,18 @@ namespace uhttp {
 
             oss << "\r\n";
 
-            if(!content.empty())
-            {
-                oss << content;
-            }
+            return oss.str();
+        }
 
-            auto rawData = oss.str();
+        DataType toRaw()
+        {
+            auto rawHeaders = headersToRaw();
 
             std::vector<char> buffer{};
 
-            buffer.insert(buffer.end(), rawData.begin(), rawData.end());
+            buffer.reserve(rawHeaders.size() + content.size());
+            buffer.insert(buffer.end(), rawHeaders.begin(), rawHeaders.end());
+            buffer.insert(buffer.end(), content.begin(), content.end());
 
             return buffer;
         }
@@ -316,6 +319,11 @@ namespace uhttp {
             content = newContent;
         }
 
+        [[nodiscard]] const std::string &getContent() const
+        {
+            return content;
+        }
+
         void setConnectionKeepAlive()
         {
             HttpHeader header{"Connection", "keep-alive"};
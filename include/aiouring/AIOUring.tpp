@@ -1,38 +1,36 @@
 
 #include "AIOUring.h"
-#include <cxxabi.h>
 
 template<typename T, typename... Args>
 requires Derived<T, AIOUringTask> && IsFinal<T> && AIOUringTaskTrait<T>
-T *AIOUring::newTask(Args... args) {
+T *AIOUring::newTask(Args&&... args) {
     if(!setupPassed)
     {
         throw AIOUringException("You have to setup() firstly.");
     }
-    T* newTask = new T{args...};
-    newTask->setUringId(getInstanceId());
-    newTask->setUring(&ring);
+    AIOUringTaskPool &pool = getTaskPool<T>();
+    void *block = pool.acquire();
+    T* newTask{nullptr};
 
-    {
-        int status;
-        char * demangled = abi::__cxa_demangle(typeid(T).name(),nullptr,nullptr,&status);
-        if(demangled != nullptr) {
-            newTask->setClassName(demangled);
-            free(demangled);
-        } else {
-            newTask->setClassName(typeid(T).name());
-        }
+    try {
+        newTask = new(block) T{std::forward<Args>(args)...};
+    } catch (...) {
+        pool.release(block);
+        throw;
     }
 
+    newTask->taskPool = &pool;
+    newTask->taskBlock = block;
+    newTask->taskId = ++taskIdGenerator;
+    newTask->setUringId(getInstanceId());
+    newTask->setUring(&ring);
+    newTask->setTaskType(AIOUringTaskTypes::id<T>(), AIOUringTaskTypes::name<T>());
+    loadMeter.taskCreated();
+
     if(!newTask->init()) {
         freeTask(newTask);
         throw AIOUringException("Failed to init new task.");
     }
-    if(*(newTask->getTaskfd().lock()) < 0) {
-        freeTask(newTask);
-        throw AIOUringException(fmt::format("Failed to create eventfd: code: "
-                                           "{}, message: ", errno, std::strerror(errno)));
-    }
     return newTask;
 }
 
@@ -43,21 +41,87 @@ void AIOUring::freeTask(T *task) {
 
     task->setState(Done);
 
+    if(task->wakeable) {
+        wakeableTasks.erase(task->taskId);
+    }
+
+    timerWheel.cancel(&task->timer);
+
+    if(task->bufferWaiting) {
+        std::erase(bufferWaiters, task);
+    }
+
+    if(task->multishotBacklog > 0) {
+        dropMultishotBacklog(task);
+    }
+
+    zeroCopyBuffers.erase(task);
+
+    if(task->parentTask != nullptr && task->parentTask->activeChild == task) {
+        task->parentTask->activeChild = nullptr;
+    }
+
     try {
         task->free();
     } catch (std::exception &e) {
         kklogging::ERROR(fmt::format("task->free(): {}", e.what()));
     }
 
-    delete task;
+    AIOUringTaskPool *pool = task->taskPool;
+    void *block = task->taskBlock;
+
+    task->~T();
+    pool->release(block);
+    loadMeter.taskFreed();
 }
 
 template<Derived<AIOUringTask> T>
 requires AIOUringTaskTrait<T>
 void AIOUring::pushTask(T *task) {
     using enum AIOUringTask::TaskState;
-    struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
-    io_uring_prep_nop(sqe);
-    sqe->user_data = reinterpret_cast<__u64>(task);
     task->setState(Running);
+    scheduleTask(task);
+}
+
+template<typename F>
+void AIOUring::awaitLongTask(AIOUringTask *task, const AIOUringJobOptions &options, F &&job) {
+    submitLongTask(task, options, [job = std::forward<F>(job)](tf::Executor *executor) mutable {
+        job(executor);
+        return 0;
+    });
+}
+
+template<typename R, typename F>
+void AIOUring::awaitLongTask(AIOUringTask *task, const AIOUringJobOptions &options, R *target, F &&job) {
+    // the task doesn't touch target until the completion is drained by the ring
+    submitLongTask(task, options, [target, job = std::forward<F>(job)](tf::Executor *executor) mutable {
+        *target = job(executor);
+        return 0;
+    });
+}
+
+template<typename T>
+requires Derived<T, AIOUringTask> && IsFinal<T> && AIOUringTaskTrait<T>
+void AIOUring::setMessageTask(uint32_t type) {
+    setMessageHandler(type, [](AIOUring *aioUring, AIOUringMessage message) {
+        aioUring->pushTask(aioUring->newTask<T>(aioUring, std::move(message)));
+    });
+}
+
+template<typename T>
+AIOUringTaskPool &AIOUring::getTaskPool() {
+    const size_t typeId = AIOUringTaskTypes::id<T>();
+
+    if(typeId >= taskPools.size())
+    {
+        taskPools.resize(typeId + 1);
+    }
+
+    if(taskPools[typeId] == nullptr)
+    {
+        taskPools[typeId] = std::make_unique<AIOUringTaskPool>(
+                typeId, AIOUringTaskTypes::name<T>(), sizeof(T), alignof(T));
+    }
+
+    return *taskPools[typeId];
 }
@@ -4,30 +4,90 @@
 #ifndef AIOURINGLONGTASK_H
 #define AIOURINGLONGTASK_H
 
+#include <chrono>
+#include <cstdint>
 #include <optional>
 #include <functional>
 #include <taskflow/taskflow.hpp>
 
+#include "AIOUringBlockingPool.h"
+#include "AIOUringMpscQueue.h"
+
 #define RUN_LONG_TASK(...) \
     aioUring->executeLongTask(AIOUringLongTask { \
         .task = __VA_ARGS__     \
     })
 
+// the job returns nothing, io_result is 0, -ECANCELED, -EBUSY if the blocking pool has shed
+// the job or -EIO if the job has thrown
 #define AWAIT_LONG_TASK(taskName, ...) \
+    AWAIT_LONG_TASK_WITH(taskName, AIOUringJobOptions{}, __VA_ARGS__)
+
+// jobOptions - AIOUringJobOptions, category and priority of the job in the blocking pool
+#define AWAIT_LONG_TASK_WITH(taskName, jobOptions, ...) \
     ___long_task_begin_##taskName:     \
-    aioUring->executeLongTask(AIOUringLongTask { \
-        .task = __VA_ARGS__     ,       \
-        .eventfd = *this->getTaskfd().lock()    \
-    });                                 \
-    AWAIT_OP(Read, taskName, *this->getTaskfd().lock(), &eventfdSink, sizeof(eventfd_t))
+    asyncStep = &&___long_task_end_##taskName; \
+    if(___async_function) {            \
+        aioUring->awaitLongTask(this, jobOptions, __VA_ARGS__); \
+        return futureOp(AIOUringOp::LongTask()); \
+    }                                  \
+    ___long_task_end_##taskName:
+
+// the value returned by the job is assigned to target, a member of the task
+#define AWAIT_LONG_TASK_RESULT(taskName, target, ...) \
+    AWAIT_LONG_TASK_RESULT_WITH(taskName, AIOUringJobOptions{}, target, __VA_ARGS__)
+
+#define AWAIT_LONG_TASK_RESULT_WITH(taskName, jobOptions, target, ...) \
+    ___long_task_begin_##taskName:     \
+    asyncStep = &&___long_task_end_##taskName; \
+    if(___async_function) {            \
+        aioUring->awaitLongTask(this, jobOptions, &(target), __VA_ARGS__); \
+        return futureOp(AIOUringOp::LongTask()); \
+    }                                  \
+    ___long_task_end_##taskName:
 
 #define ASYNC_CONTINUE_LONG_TASK(taskName) \
     asyncStep = &&___long_task_begin_##taskName; \
-    return futureOp(AIOUringOp::Nop())
+    return futureOp(AIOUringOp::Yield())
+
+class AIOUringTask;
 
 struct AIOUringLongTask {
     std::optional<std::function<void(tf::Executor *executor)>> task{std::nullopt};
     std::optional<int> eventfd{std::nullopt};
+    AIOUringJobOptions options{};
 };
 
+struct AIOUringLongTaskStats {
+    uint64_t submitted{0};
+    uint64_t completed{0};
+    // jobs waiting for an executor thread or running, and the maximum of them
+    size_t inFlight{0};
+    size_t inFlightHighWater{0};
+    // most completions drained from the queue at once
+    size_t completionBatchMax{0};
+    // writes to the wakeup eventfd, one per batch of completions
+    uint64_t wakeups{0};
+    // time from the submission to the start of the job on an executor thread
+    uint64_t queueWaitAvgNs{0};
+    uint64_t queueWaitMaxNs{0};
+    // time from the end of the job to the resumption of the task on the ring
+    uint64_t resumeLatencyAvgNs{0};
+    uint64_t resumeLatencyMaxNs{0};
+};
+
+struct AIOUringLongTaskCompletion {
+    using Clock = std::chrono::steady_clock;
+
+    AIOUringLongTaskCompletion *next{nullptr};
+    // top level task of the awaiting task
+    AIOUringTask *task{nullptr};
+    int result{0};
+    Clock::time_point submittedAt{};
+    Clock::time_point startedAt{};
+    Clock::time_point finishedAt{};
+};
+
+using AIOUringLongTaskQueue = AIOUringMpscQueue<AIOUringLongTaskCompletion>;
+
 #endif //AIOURINGLONGTASK_H
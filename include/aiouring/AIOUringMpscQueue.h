@@ -0,0 +1,70 @@
+#ifndef AIOURINGMPSCQUEUE_H
+#define AIOURINGMPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+/**
+ * Lock-free queue of intrusive nodes (T::next) allocated with new: any thread pushes, the
+ * ring thread takes all of them at once. The producer which finds the queue empty wakes the
+ * ring, the others don't. Nodes left in the queue are deleted with it.
+ */
+template<typename T>
+class AIOUringMpscQueue {
+public:
+    AIOUringMpscQueue() = default;
+    ~AIOUringMpscQueue();
+    AIOUringMpscQueue(const AIOUringMpscQueue &) = delete;
+    AIOUringMpscQueue &operator=(const AIOUringMpscQueue &) = delete;
+
+    // true if the queue was empty, the consumer has to be woken
+    bool push(T *node) noexcept;
+    // nodes in the order they were pushed, nullptr if there are none
+    T *drain() noexcept;
+    [[nodiscard]] bool empty() const noexcept;
+private:
+    std::atomic<T *> head{nullptr};
+};
+
+template<typename T>
+AIOUringMpscQueue<T>::~AIOUringMpscQueue() {
+    for(T *node = drain(); node != nullptr;)
+    {
+        delete std::exchange(node, node->next);
+    }
+}
+
+template<typename T>
+bool AIOUringMpscQueue<T>::push(T *node) noexcept {
+    T *expected = head.load(std::memory_order_relaxed);
+
+    do
+    {
+        node->next = expected;
+    }
+    while(!head.compare_exchange_weak(expected, node, std::memory_order_release,
+                                      std::memory_order_relaxed));
+
+    return expected == nullptr;
+}
+
+template<typename T>
+T *AIOUringMpscQueue<T>::drain() noexcept {
+    T *node = head.exchange(nullptr, std::memory_order_acquire);
+    T *ordered = nullptr;
+
+    // the stack holds the latest node first
+    while(node != nullptr)
+    {
+        ordered = std::exchange(node, std::exchange(node->next, ordered));
+    }
+
+    return ordered;
+}
+
+template<typename T>
+bool AIOUringMpscQueue<T>::empty() const noexcept {
+    return head.load(std::memory_order_relaxed) == nullptr;
+}
+
+#endif //AIOURINGMPSCQUEUE_H
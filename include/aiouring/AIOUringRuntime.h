@@ -0,0 +1,75 @@
+#ifndef AIOURINGRUNTIME_H
+#define AIOURINGRUNTIME_H
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "AIOUring.h"
+
+/**
+ * Thread-per-core runtime: starts one AIOUring per worker thread, each thread is pinned
+ * to its own cpu of the affinity mask of the process. The first ring owns the kernel async worker pool, the rest of the rings
+ * attach to it through IORING_SETUP_ATTACH_WQ.
+ */
+class AIOUringRuntime {
+public:
+    using RingInitializer = std::function<void(AIOUring *aioUring)>;
+
+    // each ring is set up and run by its own thread, so the single issuer flags are on
+    explicit AIOUringRuntime(unsigned threadsNumber = 0, bool useSQPoll = false, bool pinThreads = true);
+    // setupOptions apply to every ring, see threadOptions()
+    AIOUringRuntime(unsigned threadsNumber, AIOUringSetupOptions setupOptions, bool pinThreads = true);
+
+    // options with the flags which need the ring to stay on one thread turned on
+    static AIOUringSetupOptions threadOptions(AIOUringSetupOptions setupOptions = {});
+
+    void onEachRing(RingInitializer initializer);
+    // balancing of connections and offered work between the rings, std::nullopt - off
+    void setBalanceOptions(std::optional<AIOUringBalanceOptions> options);
+
+    template<typename T, typename... Args>
+    requires Derived<T, AIOUringTask> && IsFinal<T> && AIOUringTaskTrait<T>
+    void pushTaskOnEach(Args... args);
+
+    int run();
+    void stop(int code = 0);
+
+    [[nodiscard]] unsigned getThreadsNumber() const;
+    // nullptr until the ring of the thread is set up
+    AIOUring *getRing(unsigned index);
+    // sends the message from the ring to every other started ring, the message must not carry an fd
+    void broadcast(AIOUring *from, const AIOUringMessage &message);
+    // empty if balancing is off or the runtime isn't running
+    [[nodiscard]] std::vector<AIOUringLoad> getLoads();
+
+private:
+    unsigned threadsNumber{1};
+    AIOUringSetupOptions setupOptions{};
+    bool pinThreads{true};
+    std::vector<RingInitializer> initializers{};
+    std::optional<AIOUringBalanceOptions> balanceOptions{AIOUringBalanceOptions{}};
+    std::unique_ptr<AIOUringBalancer> balancer{};
+    std::vector<std::unique_ptr<AIOUring>> rings{};
+    std::mutex ringsMutex{};
+    // cpus the process may run on, taken when run() starts
+    std::vector<unsigned> cpus{};
+    bool stopped{false};
+    int stoppedCode{0};
+
+    int runRing(unsigned index, std::optional<int> backendRingFd, std::promise<int> *backendPromise);
+    void pinThread(unsigned index) const;
+    [[nodiscard]] AIOUringSetupOptions ringOptions(unsigned index) const;
+    static std::vector<unsigned> allowedCpus();
+};
+
+template<typename T, typename... Args>
+requires Derived<T, AIOUringTask> && IsFinal<T> && AIOUringTaskTrait<T>
+void AIOUringRuntime::pushTaskOnEach(Args... args) {
+    onEachRing([=](AIOUring *aioUring) {
+        aioUring->pushTask(aioUring->newTask<T>(aioUring, args...));
+    });
+}
+
+#endif //AIOURINGRUNTIME_H
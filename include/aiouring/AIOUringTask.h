@@ -9,17 +9,20 @@
 #include <type_traits>
 #include <exception>
 #include <string>
+#include <string_view>
 #include <optional>
 #include <unistd.h>
 #include <sys/eventfd.h>
-#include <any>
 #include <tuple>
 #include <liburing.h>
 #include <variant>
 #include <memory>
+#include <cstdint>
+#include <fmt/core.h>
 
 #include "AIOUringOp.h"
 #include "AIOUringLongTask.h"
+#include "AIOUringTimerWheel.h"
 
 #define ASYNC_IO \
     constexpr bool ___async_function{true}; \
@@ -44,50 +47,65 @@
     AWAIT_OP_NL(opName, ## __VA_ARGS__)  \
     ___op_end_##labelName:
 
+#define AWAIT_OP_TIMEOUT_NL(opName, timeout, ...) \
+    if(___async_function) {      \
+        return futureOp(AIOUringOp::opName(__VA_ARGS__).withTimeout(timeout)); \
+    }
+
+#define AWAIT_OP_TIMEOUT(opName, labelName, timeout, ...) \
+    ___op_begin_##labelName:                   \
+    asyncStep = &&___op_end_##labelName;       \
+    AWAIT_OP_TIMEOUT_NL(opName, timeout, ## __VA_ARGS__)  \
+    ___op_end_##labelName:
+
 #define AWAIT_CONTINUE_OP(labelName) \
     goto ___op_begin_##labelName
 
 #define ASYNC_CONTINUE_OP(labelName) \
     asyncStep = &&___op_begin_##labelName; \
-    return futureOp(AIOUringOp::Nop());
+    return futureOp(AIOUringOp::Yield());
 
 #define TASK_RESULT(result) \
-    futureResult(std::make_any<TResult>((result)))
+    futureValue<TResult>((result))
 
 #define TASK_RESULT_NONE() \
     TASK_RESULT(std::monostate{})
 
-#define TASK_ERROR(error_text) \
-    futureResult(std::make_any<std::runtime_error>(error_text))
+// the text is formatted into the error itself: TASK_ERROR("Error on binding port {}", port)
+#define TASK_ERROR(...) \
+    futureErrorFormat(0, __VA_ARGS__)
+
+#define TASK_ERROR_WITH_CODE(code, ...) \
+    futureErrorFormat((code), __VA_ARGS__)
 
 #define TASK_HAS_OPTIONAL_RESULT(taskName) \
-    (taskName##_result.has_value() && \
-        (*taskName##_result).has_value())
+    (taskName##_outcome.hasValue() && \
+        taskName##_outcome.value().has_value())
 
 #define TASK_HAS_RESULT(taskName) \
-    (taskName##_result.has_value())
+    (taskName##_outcome.hasValue())
 
 #define TASK_RESULT_VALUE(taskName) \
-    (*taskName##_result)
+    (taskName##_outcome.value())
 
 #define TASK_OPTIONAL_VALUE(taskName) \
-    (*taskName##_result).value()
+    taskName##_outcome.value().value()
 
 #define TASK_HAS_ERROR(taskName) \
-    taskName##_error.has_value()
+    taskName##_outcome.hasError()
 
 #define TASK_ERROR_TEXT(taskName) \
-    (*taskName##_error).what()
+    taskName##_outcome.error().what()
+
+#define TASK_ERROR_CODE(taskName) \
+    taskName##_outcome.error().code
 
 #define AIOURING_SHUTDOWN(code) \
     return futureOp(AIOUringOp::ShutdownUring(code))
 
 #define TASK_DEF(task_class, taskName) \
-    std::optional<task_class::TResult> taskName##_result{std::nullopt}; \
-    std::optional<std::runtime_error> taskName##_error{std::nullopt};\
+    AIOUringTaskOutcome<task_class::TResult> taskName##_outcome{}; \
     TaskFuture ___task_future_##taskName{};                          \
-    std::optional<AIOUringOp> ___task_ok_##taskName{std::nullopt};    \
-    std::optional<std::any> ___task_result_##taskName{std::nullopt}; \
     task_class *taskName{nullptr}
 
 #define AWAIT_TASKNL2(taskName, lbSuffix, ...) \
@@ -106,49 +124,37 @@
             throw std::runtime_error(fmt::format("{}: aioUring is null", this->getClassName())); \
         }                         \
         this->taskName = aioUring->newTask<std::remove_pointer_t<decltype(taskName)>>(__VA_ARGS__); \
+        taskName##_outcome.reset();                                                             \
+        this->taskName->bindOutcome(&taskName##_outcome);                                       \
+        this->attachChild(this->taskName);                                                      \
     }                             \
     ___task_begin_##taskName##lbSuffix:     \
     ___task_future_##taskName = this->taskName->poll(io_result);                                \
-    ___task_ok_##taskName = std::get<0>(___task_future_##taskName);                             \
-    if(___task_ok_##taskName.has_value()) {                                                     \
+    if(std::get<0>(___task_future_##taskName).has_value()) {                                    \
         asyncStep = &&___task_begin_##taskName##lbSuffix;                                                 \
         return ___task_future_##taskName;                                                       \
     } else {                      \
         aioUring->freeTask(this->taskName);                                                      \
         this->taskName = nullptr; \
     }                             \
-    ___task_result_##taskName = std::get<1>(___task_future_##taskName);                         \
-    taskName##_result = std::nullopt;                                                           \
-    taskName##_error = std::nullopt;                                                            \
-    if(___task_result_##taskName.has_value()) {                                                 \
-        if(!std::is_same<typename std::remove_pointer_t<decltype(taskName)>::TResult, std::monostate>()) {  \
-            try {                 \
-                taskName##_result = std::make_optional<typename std::remove_pointer_t<decltype(taskName)>::TResult>( \
-                    std::any_cast<typename std::remove_pointer_t<decltype(taskName)>::TResult>(*___task_result_##taskName)); \
-            } catch(...) {}       \
-        }                         \
-        if(!taskName##_result.has_value()) {                                                    \
-            try {                 \
-                taskName##_error = std::make_optional<std::runtime_error>(                      \
-                    std::any_cast<std::runtime_error>(*___task_result_##taskName));             \
-            } catch(...) {}       \
-        }                         \
+    if(std::get<1>(___task_future_##taskName).has_value()) {                                    \
+        taskName##_outcome.setError(std::move(*std::get<1>(___task_future_##taskName)));        \
     }
 
 #define ASYNC_CONTINUE_TASK(taskName) \
     asyncStep = &&___task_create_##taskName; \
-    return futureOp(AIOUringOp::Nop());
+    return futureOp(AIOUringOp::Yield());
 
 #define ASYNC_LOOP(loopName) \
     ___async_loop_begin_##loopName:
 
 #define AWAIT_LOOP(loopName) \
     asyncStep = &&___async_loop_begin_##loopName; \
-    return futureOp(AIOUringOp::Nop());
+    return futureOp(AIOUringOp::Yield());
 
 #define AWAIT_POLL() \
     ASYNC_RESET()    \
-    return futureOp(AIOUringOp::Nop())
+    return futureOp(AIOUringOp::Yield())
 
 #define AWAIT_EVENT_INT(fdname, cnt) \
     if(___async_function) {          \
@@ -179,6 +185,38 @@
 #define EVENT_NOTIFY(eventfd) \
     eventfd_write((eventfd), 1L)
 
+#define AWAIT_DEADLINE_INT(timePoint, cnt) \
+    if(___async_function) {          \
+        asyncStep = &&___await_deadline_##cnt; \
+    }                                \
+    return futureOp(AIOUringOp::Deadline(timePoint)); \
+    ___await_deadline_##cnt:
+
+#define AWAIT_DEADLINE2(timePoint, cnt) \
+    AWAIT_DEADLINE_INT(timePoint, cnt)
+
+#define AWAIT_DEADLINE(timePoint) \
+    AWAIT_DEADLINE2(timePoint, __COUNTER__)
+
+#define AWAIT_SLEEP(duration) \
+    AWAIT_DEADLINE(std::chrono::steady_clock::now() + (duration))
+
+#define AWAIT_WAKE_INT(cnt) \
+    if(___async_function && !this->consumeWake()) { \
+        asyncStep = &&___await_wake_##cnt; \
+        return futureOp(AIOUringOp::Park(this)); \
+        ___await_wake_##cnt: \
+        if(io_result != -ECANCELED && !this->consumeWake()) { \
+            return futureOp(AIOUringOp::Park(this)); \
+        }                   \
+    }
+
+#define AWAIT_WAKE2(cnt) \
+    AWAIT_WAKE_INT(cnt)
+
+#define AWAIT_WAKE() \
+    AWAIT_WAKE2(__COUNTER__)
+
 template<class T, class U>
 concept Derived = std::is_base_of<U, T>::value;
 
@@ -202,7 +240,67 @@ private:
     std::string message;
 };
 
+/**
+ * Error a task ends with. The text is kept inline, a storm of failing connections doesn't
+ * allocate; longer texts are truncated.
+ */
+struct AIOUringTaskError {
+    static constexpr size_t textSize = 120;
+
+    int code{0};
+    char text[textSize]{};
+
+    [[nodiscard]] const char* what() const noexcept {
+        return text;
+    }
+};
+
+/**
+ * Outcome of a child task declared by TASK_DEF: either nothing yet, a value of
+ * the child's TResult or an error. The child writes its value directly here,
+ * so no type erasure is involved.
+ */
+template<typename T>
+class AIOUringTaskOutcome {
+public:
+    void reset() {
+        state.template emplace<0>();
+    }
+    void setValue(T value) {
+        state.template emplace<1>(std::move(value));
+    }
+    void setError(AIOUringTaskError error) {
+        state.template emplace<2>(std::move(error));
+    }
+    [[nodiscard]] bool hasValue() const {
+        return state.index() == 1;
+    }
+    [[nodiscard]] bool hasError() const {
+        return state.index() == 2;
+    }
+    T &value() {
+        return *std::get_if<1>(&state);
+    }
+    const AIOUringTaskError &error() const {
+        return *std::get_if<2>(&state);
+    }
+private:
+    std::variant<std::monostate, T, AIOUringTaskError> state{};
+};
+
+/**
+ * Handle of a task for AIOUring::wake(). It stays safe to use after the task is freed,
+ * waking a freed task does nothing.
+ */
+struct AIOUringTaskRef {
+    uint64_t taskId{0};
+};
+
+class AIOUring;
+class AIOUringTaskPool;
+
 class AIOUringTask {
+    friend class AIOUring;
 public:
     using TResult = std::monostate;
 
@@ -212,24 +310,32 @@ public:
         Done
     };
 
-    using TaskFuture = std::tuple<std::optional<AIOUringOp>, std::optional<std::any>>;
+    using TaskFuture = std::tuple<std::optional<AIOUringOp>, std::optional<AIOUringTaskError>>;
 
     AIOUringTask();
     void setUringId(int id);
     [[nodiscard]] int getUringId() const;
     virtual ~AIOUringTask() = default;
-    [[nodiscard]] std::weak_ptr<int> getTaskfd() const;
+    int getEventfd();
     void setState(TaskState newState);
     [[nodiscard]] TaskState getState() const;
     void setUring(io_uring *newRing);
-    void setClassName(std::string className);
-    [[nodiscard]] std::string getClassName() const;
+    void setTaskType(size_t typeId, std::string_view className);
+    [[nodiscard]] size_t getTaskTypeId() const;
+    [[nodiscard]] std::string_view getClassName() const;
     void asyncReset();
     void setTaskFinal();
     bool isTaskFinal();
+    [[nodiscard]] bool isCancelled() const;
     static TaskFuture futureEmpty();
-    static TaskFuture futureResult(std::any result);
+    static TaskFuture futureError(int code, std::string_view message);
+    template<typename... Args>
+    static TaskFuture futureErrorFormat(int code, fmt::format_string<Args...> format, Args &&...args);
     static TaskFuture futureOp(AIOUringOp op);
+    template<typename T>
+    void bindOutcome(AIOUringTaskOutcome<T> *outcome);
+    template<typename T>
+    TaskFuture futureValue(T value);
     virtual bool init();
     virtual void free();
     virtual TaskFuture finally(int io_result);
@@ -239,14 +345,94 @@ protected:
     io_uring *ring{nullptr};
     eventfd_t eventfdSink{};
     eventfd_t eventfdValue{1};
+
+    bool consumeWake();
+    void attachChild(AIOUringTask *child);
 private:
-    std::shared_ptr<int> taskfd{};
+    // created on first getEventfd(), only tasks signalled from other threads need it
+    int taskfd{-1};
     int uringId{-1};
+    uint64_t taskId{0};
     TaskState taskState{TaskState::New};
-    std::string className{};
+    size_t taskTypeId{0};
+    std::string_view className{};
     bool finalization{false};
+    // slab block the task is constructed in
+    AIOUringTaskPool *taskPool{nullptr};
+    void *taskBlock{nullptr};
+    // AIOUringTaskOutcome<TResult> of the awaiting parent task
+    void *outcome{nullptr};
+    // userspace ready queue of the ring
+    AIOUringTask *readyNext{nullptr};
+    int readyResult{0};
+    // AWAIT_WAKE state, wakeRoot is the top level task to reschedule on wake
+    bool wakeable{false};
+    bool parked{false};
+    unsigned pendingWakes{0};
+    AIOUringTask *wakeRoot{nullptr};
+    // timeout of the op in flight, read by the kernel on submission
+    __kernel_timespec opTimeout{};
+    // AWAIT_SLEEP/AWAIT_DEADLINE timer of the top level task
+    AIOUringTimer timer{};
+    // AWAIT_TASK chain, the op in flight of a top level task belongs to its deepest child
+    AIOUringTask *parentTask{nullptr};
+    AIOUringTask *activeChild{nullptr};
+    bool inFlight{false};
+    // kind of the op in flight, the bytes of its completion count towards the load of the ring
+    AIOUringOp::Kind inFlightKind{AIOUringOp::Kind::Empty};
+    // buffer-select op in flight, kept to resubmit it on -ENOBUFS
+    AIOUringOp bufferSelectOp{};
+    // the buffer-select op waits in AIOUring for free buffers of its group
+    bool bufferWaiting{false};
+    // multishot op of the top level task, armed until its CQE without IORING_CQE_F_MORE;
+    // its completions which come while the task isn't waiting for them are kept in AIOUring
+    AIOUringOp multishotOp{};
+    bool multishotArmed{false};
+    bool multishotWaiting{false};
+    size_t multishotBacklog{0};
+    // SendZC sends with a notification to come, notifications received,
+    // ZeroCopyFlush waits until no more than zeroCopyKeep of them are pending
+    uint64_t zeroCopySent{0};
+    uint64_t zeroCopyNotified{0};
+    bool zeroCopyWaiting{false};
+    uint64_t zeroCopyKeep{0};
+    // AWAIT_LONG_TASK job of the chain runs on the executor, the task is resumed by its completion
+    bool longTaskRunning{false};
+    // the task is done but the kernel still refers to it (multishot op armed or SendZC
+    // notifications pending), freed on the last CQE
+    bool freePending{false};
+    // CQE flags of the completion the task is scheduled with
+    unsigned readyFlags{0};
+    bool cancelled{false};
+    // set on the top level task until -ECANCELED is delivered to its chain
+    bool cancelPending{false};
+
+    [[nodiscard]] uint64_t zeroCopyPending() const { return zeroCopySent - zeroCopyNotified; }
 };
 
+template<typename T>
+void AIOUringTask::bindOutcome(AIOUringTaskOutcome<T> *taskOutcome) {
+    outcome = taskOutcome;
+}
+
+template<typename... Args>
+AIOUringTask::TaskFuture AIOUringTask::futureErrorFormat(int code, fmt::format_string<Args...> format, Args &&...args) {
+    TaskFuture future{std::nullopt, AIOUringTaskError{.code = code}};
+    char *text = std::get<1>(future)->text;
+
+    *fmt::format_to_n(text, AIOUringTaskError::textSize - 1, format, std::forward<Args>(args)...).out = '\0';
+
+    return future;
+}
+
+template<typename T>
+AIOUringTask::TaskFuture AIOUringTask::futureValue(T value) {
+    if(outcome != nullptr) {
+        static_cast<AIOUringTaskOutcome<T> *>(outcome)->setValue(std::move(value));
+    }
+    return futureEmpty();
+}
+
 template <typename T>
 concept AIOUringTaskTrait = requires(T c) {
     c.free();
@@ -254,10 +440,10 @@ concept AIOUringTaskTrait = requires(T c) {
     c.setUringId(int{});
     c.setState(AIOUringTask::TaskState{});
     c.setUring((io_uring*){});
-    c.setClassName(std::string{});
+    c.setTaskType(size_t{}, std::string_view{});
     c.setTaskFinal();
     { c.init() } -> std::same_as<bool>;
-    { c.getTaskfd() } -> std::same_as<std::weak_ptr<int>>;
+    { c.getEventfd() } -> std::same_as<int>;
     { c.finally(int{}) } -> std::same_as<AIOUringTask::TaskFuture>;
     { c.isTaskFinal() } -> std::same_as<bool>;
 };
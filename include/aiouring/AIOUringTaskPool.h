@@ -0,0 +1,87 @@
+#ifndef AIOURINGTASKPOOL_H
+#define AIOURINGTASKPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+
+/**
+ * Dense per-process index and class name of task types. Both are computed once per
+ * type, the id addresses per-type pools and metrics of a ring.
+ */
+class AIOUringTaskTypes {
+public:
+    template<typename T>
+    static size_t id() {
+        static const size_t typeId = counter.fetch_add(1);
+        return typeId;
+    }
+
+    template<typename T>
+    static std::string_view name() {
+        static const std::string className = demangle(typeid(T).name());
+        return className;
+    }
+private:
+    inline static std::atomic<size_t> counter{0};
+
+    static std::string demangle(const char *mangledName);
+};
+
+struct AIOUringTaskPoolStats {
+    size_t typeId{0};
+    std::string_view className{};
+    size_t objectSize{0};
+    // tasks alive right now
+    size_t live{0};
+    // maximum of simultaneously alive tasks
+    size_t highWater{0};
+    // blocks allocated in slabs, retained for reuse
+    size_t capacity{0};
+    size_t slabs{0};
+    // total tasks created and how many of them reused a freed block
+    uint64_t acquired{0};
+    uint64_t recycled{0};
+};
+
+/**
+ * Free-list slab allocator for tasks of a single type, owned by one ring.
+ * Freed blocks are reused LIFO, so the most recently released (cache-warm) block
+ * is handed out first. Slabs are kept until the ring is destroyed.
+ */
+class AIOUringTaskPool {
+public:
+    AIOUringTaskPool(size_t typeId, std::string_view className, size_t objectSize, size_t objectAlign);
+    ~AIOUringTaskPool();
+    AIOUringTaskPool(const AIOUringTaskPool &) = delete;
+    AIOUringTaskPool &operator=(const AIOUringTaskPool &) = delete;
+
+    void *acquire();
+    void release(void *block);
+
+    [[nodiscard]] const AIOUringTaskPoolStats &getStats() const;
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    static constexpr size_t slabBytes = 64 * 1024;
+    static constexpr size_t maxBlocksPerSlab = 64;
+
+    size_t blockSize{0};
+    size_t blockAlign{0};
+    size_t blocksPerSlab{1};
+    FreeBlock *freeBlocks{nullptr};
+    std::vector<void *> slabs{};
+    AIOUringTaskPoolStats stats{};
+
+    void grow();
+};
+
+#endif //AIOURINGTASKPOOL_H
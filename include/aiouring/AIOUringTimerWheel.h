@@ -0,0 +1,115 @@
+#ifndef AIOURINGTIMERWHEEL_H
+#define AIOURINGTIMERWHEEL_H
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/**
+ * Intrusive timer node, embedded into its owner, so arming a timer doesn't allocate.
+ */
+struct AIOUringTimer {
+    AIOUringTimer *prev{nullptr};
+    AIOUringTimer *next{nullptr};
+    uint64_t expiresTick{0};
+    // slot of the wheel the timer is linked to, -1 - not armed
+    int slot{-1};
+    void *owner{nullptr};
+
+    [[nodiscard]] bool isArmed() const { return slot >= 0; }
+};
+
+/**
+ * Hierarchical timer wheel with 1ms ticks: 4 levels of 64 slots cover ~4.6 hours, later
+ * deadlines are parked in the last slot of the top level and re-inserted on cascade.
+ * Arm and cancel are O(1). Owned by one ring and driven from AIOUring::run().
+ */
+class AIOUringTimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit AIOUringTimerWheel(Clock::time_point origin = Clock::now());
+
+    // returns false if the deadline has already passed, the timer is not armed then
+    bool arm(AIOUringTimer *timer, Clock::time_point deadline);
+    void cancel(AIOUringTimer *timer);
+
+    template<typename F>
+    void expire(Clock::time_point now, F &&onExpired);
+
+    [[nodiscard]] std::optional<Clock::time_point> nextExpiry() const;
+    [[nodiscard]] size_t size() const;
+private:
+    static constexpr unsigned levelBits = 6;
+    static constexpr unsigned slotsPerLevel = 1u << levelBits;
+    static constexpr uint64_t slotMask = slotsPerLevel - 1;
+    static constexpr unsigned levels = 4;
+    static constexpr std::chrono::nanoseconds tick = std::chrono::milliseconds{1};
+
+    Clock::time_point origin;
+    uint64_t currentTick{0};
+    size_t armed{0};
+    std::array<AIOUringTimer *, levels * slotsPerLevel> slots{};
+    std::array<uint64_t, levels> occupied{};
+
+    [[nodiscard]] uint64_t ticksFloor(Clock::time_point timePoint) const;
+    [[nodiscard]] uint64_t ticksCeil(Clock::time_point timePoint) const;
+    void insert(AIOUringTimer *timer);
+    AIOUringTimer *takeSlot(unsigned slot);
+    void cascade();
+};
+
+template<typename F>
+void AIOUringTimerWheel::expire(Clock::time_point now, F &&onExpired) {
+    const uint64_t nowTick = ticksFloor(now);
+
+    while(currentTick < nowTick)
+    {
+        if(armed == 0)
+        {
+            currentTick = nowTick;
+            return;
+        }
+
+        // jump to the next occupied slot of the first level or to the next cascade
+        const uint64_t index = currentTick & slotMask;
+        const uint64_t pending = index == slotMask ? 0 : occupied[0] & (~uint64_t{0} << (index + 1));
+        const uint64_t nextTick = pending != 0 ?
+                (currentTick & ~slotMask) + std::countr_zero(pending) :
+                (currentTick & ~slotMask) + slotsPerLevel;
+
+        if(nextTick > nowTick)
+        {
+            currentTick = nowTick;
+            return;
+        }
+
+        currentTick = nextTick;
+
+        if((currentTick & slotMask) == 0)
+        {
+            cascade();
+        }
+
+        AIOUringTimer *timer = takeSlot(currentTick & slotMask);
+
+        while(timer != nullptr)
+        {
+            AIOUringTimer *next = timer->next;
+
+            timer->prev = nullptr;
+            timer->next = nullptr;
+            timer->slot = -1;
+            --armed;
+
+            onExpired(timer);
+
+            timer = next;
+        }
+    }
+}
+
+#endif //AIOURINGTIMERWHEEL_H
@@ -22,8 +22,10 @@ class TCPConnectTask final : public AIOUringTask {
 public:
     using TResult = int;
 
-    explicit TCPConnectTask(AIOUring *aioUring, std::string hostname, int tcpPort)
-            : aioUring(aioUring), hostname(std::move(hostname)), tcpPort(tcpPort) {}
+    explicit TCPConnectTask(AIOUring *aioUring, std::string hostname, int tcpPort,
+                            std::chrono::milliseconds connectTimeout = std::chrono::milliseconds{0})
+            : aioUring(aioUring), hostname(std::move(hostname)), tcpPort(tcpPort),
+              connectTimeout(connectTimeout) {}
 
     TaskFuture poll(int io_result) override {
         ASYNC_IO;
@@ -31,11 +33,11 @@ public:
         AWAIT_TASK(resolveHostTask, hostname);
 
         if(TASK_HAS_ERROR(resolveHostTask)) {
-            return TASK_ERROR(TASK_ERROR_TEXT(resolveHostTask));
+            return TASK_ERROR("{}", TASK_ERROR_TEXT(resolveHostTask));
         } else if(TASK_HAS_OPTIONAL_RESULT(resolveHostTask)) {
             resolveResult = std::move(TASK_OPTIONAL_VALUE(resolveHostTask));
         } else {
-            return TASK_ERROR(fmt::format("No ip address for hostname {}", hostname));
+            return TASK_ERROR("No ip address for hostname {}", hostname);
         }
 
         clientAddr = std::get<0>(resolveResult);
@@ -45,7 +47,7 @@ public:
 
         if(tcpSocket < 0)
         {
-            return TASK_ERROR(fmt::format("Failed to create TCP socket: {}", std::string(strerror(errno))));
+            return TASK_ERROR("Failed to create TCP socket: {}", strerror(errno));
         }
 
         unet::setTcpKeepAliveCfg(tcpSocket, unet::TcpKeepAliveConfig{
@@ -54,7 +56,19 @@ public:
                 .keepintvl = 1
         });
 
-        AWAIT_OP(Connect, tcpConnect, tcpSocket, reinterpret_cast<
+        if(aioUring->hasFileTable()) {
+            fileSlot = tcpSocket;
+
+            AWAIT_OP(InstallFile, installSocket, &fileSlot);
+
+            if(io_result == 1) {
+                // the table holds its own reference to the socket
+                close(tcpSocket);
+                tcpSocket = AIOUringOp::directFd(fileSlot);
+            }
+        }
+
+        AWAIT_OP_TIMEOUT(Connect, tcpConnect, connectTimeout, tcpSocket, reinterpret_cast<
                 struct sockaddr *>(&clientAddr), sizeof(clientAddr));
 
         if(io_result == 0)
@@ -62,11 +76,12 @@ public:
             return TASK_RESULT(tcpSocket);
         }
 
-        socketErrno = io_result;
+        // connect canceled by its linked timeout
+        socketErrno = io_result == -ECANCELED ? -ETIMEDOUT : io_result;
 
         AWAIT_OP(Close, socketClose, tcpSocket);
 
-        return TASK_ERROR(fmt::format("Error on tcp connection: {}", uexcept::errnoStr(-socketErrno)));
+        return TASK_ERROR_WITH_CODE(socketErrno, "Error on tcp connection: {}", strerror(-socketErrno));
     }
 
 private:
@@ -76,7 +91,9 @@ private:
     sockaddr_in clientAddr{};
     std::string hostname{};
     int tcpPort{};
+    std::chrono::milliseconds connectTimeout{0};
     int tcpSocket{-1};
+    int fileSlot{-1};
     int socketErrno{};
 };
 
@@ -8,6 +8,7 @@
 #include "aiouring/AIOUring.h"
 #include <aioutils/uexcept.h>
 #include <aioutils/unet.h>
+#include <cstring>
 #include <arpa/inet.h>
 
 template<typename TAcceptTask>
@@ -15,11 +16,28 @@ requires Derived<TAcceptTask, AIOUringTask> &&
          IsFinal<TAcceptTask> && AIOUringTaskTrait<TAcceptTask>
 class TCPListeningTask final : public AIOUringTask {
 public:
-    explicit TCPListeningTask(AIOUring *aioUring, int tcpListeningPort, int maxBacklogConnections)
+    explicit TCPListeningTask(AIOUring *aioUring, int tcpListeningPort, int maxBacklogConnections,
+                              bool multishotAccept = true)
             :
             aioUring(aioUring),
             tcpListeningPort(tcpListeningPort),
-            maxBacklogConnections(maxBacklogConnections) {}
+            maxBacklogConnections(maxBacklogConnections),
+            multishotAccept(multishotAccept && aioUring->supportsMultishotAccept()) {
+        // connections accepted by a hot ring may start on another one, see AIOUring::distribute()
+        aioUring->setMessageHandler(acceptMessageType(), [](AIOUring *ring, AIOUringMessage message) {
+            sockaddr_in clientAddr{};
+
+            clientAddr.sin_family = AF_INET;
+            clientAddr.sin_port = static_cast<in_port_t>(message.value & 0xffff);
+            clientAddr.sin_addr.s_addr = static_cast<in_addr_t>(message.value >> 16);
+
+            ring->pushTask(ring->newTask<TAcceptTask>(ring, message.fd, clientAddr));
+        });
+    }
+
+    static uint32_t acceptMessageType() {
+        return AIOUringMessage::reservedTypes | static_cast<uint32_t>(AIOUringTaskTypes::id<TAcceptTask>());
+    }
 
     TaskFuture poll(int io_result) override {
         using namespace aioutils;
@@ -29,7 +47,7 @@ public:
         tcpSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 
         if(tcpSocket < 0) {
-            return TASK_ERROR(fmt::format("Error on creating socket: {}", uexcept::errnoStr(errno)));
+            return TASK_ERROR("Error on creating socket: {}", strerror(errno));
         }
 
         unet::setSocketReuseOptions(tcpSocket);
@@ -47,27 +65,85 @@ public:
         if(bind(tcpSocket, reinterpret_cast<struct
                 sockaddr *>(&serviceAddr), sizeof(serviceAddr)) != 0)
         {
-            return TASK_ERROR(fmt::format("Error on binding port {}: {}",
-                                          tcpListeningPort, uexcept::errnoStr(errno)));
+            return TASK_ERROR("Error on binding port {}: {}", tcpListeningPort, strerror(errno));
         }
 
         if(listen(tcpSocket, maxBacklogConnections) < 0) {
-            return TASK_ERROR(fmt::format("Error on listening socket: {}",
-                                          uexcept::errnoStr(errno)));
+            return TASK_ERROR("Error on listening socket: {}", strerror(errno));
         }
 
-        AWAIT_OP(Accept, acceptClient, tcpSocket, reinterpret_cast<struct
-                sockaddr *>(&client_addr), &sockaddr_in_len);
+        if(aioUring->hasFileTable()) {
+            fileSlot = tcpSocket;
+
+            AWAIT_OP(InstallFile, installSocket, &fileSlot);
+
+            if(io_result == 1) {
+                // the table holds its own reference to the socket
+                close(tcpSocket);
+                tcpSocket = AIOUringOp::directFd(fileSlot);
+            }
+        }
+
+        ASYNC_LOOP(acceptClient);
+
+        if(multishotAccept) {
+            // one sqe accepts until canceled; a multishot accept has no room for the peer address,
+            // so the socket comes as a plain fd for getpeername() and moves into the file table then
+            AWAIT_OP(AcceptMultishot, acceptMultishot, tcpSocket);
+
+            if(io_result >= 0) {
+                client_addr = sockaddr_in{};
+                sockaddr_in_len = sizeof(struct sockaddr_in);
+                getpeername(io_result, reinterpret_cast<struct sockaddr *>(&client_addr), &sockaddr_in_len);
+            }
+
+            if(io_result >= 0 && AIOUringOp::isDirectFd(tcpSocket)) {
+                acceptedSocket = io_result;
+                fileSlot = acceptedSocket;
+
+                AWAIT_OP(InstallFile, installClient, &fileSlot);
+
+                if(io_result == 1) {
+                    close(acceptedSocket);
+                    io_result = AIOUringOp::directFd(fileSlot);
+                } else {
+                    // the table is full, the connection goes on with the plain fd
+                    io_result = acceptedSocket;
+                }
+            }
+        } else if(AIOUringOp::isDirectFd(tcpSocket)) {
+            // accepted sockets go straight into the file table
+            AWAIT_OP(AcceptDirect, acceptDirect, tcpSocket, reinterpret_cast<struct
+                    sockaddr *>(&client_addr), &sockaddr_in_len);
+
+            if(io_result >= 0) {
+                io_result = AIOUringOp::directFd(io_result);
+            }
+        } else {
+            AWAIT_OP(Accept, acceptRaw, tcpSocket, reinterpret_cast<struct
+                    sockaddr *>(&client_addr), &sockaddr_in_len);
+        }
+
+        if(io_result == -ECANCELED)
+        {
+            AWAIT_OP(Close, closeSocket, tcpSocket);
+            return TASK_RESULT_NONE();
+        }
 
         if(io_result < 0)
         {
             kklogging::ERROR(fmt::format("Error on accepting tcp connection: {}",
                                          uexcept::errnoStr(-io_result)));
+            AWAIT_LOOP(acceptClient);
         }
 
-        aioUring->pushTask(aioUring->newTask<TAcceptTask>(aioUring, io_result, client_addr));
+        aioUring->distribute(AIOUringMessage{
+                .type = acceptMessageType(),
+                .value = (static_cast<uint64_t>(client_addr.sin_addr.s_addr) << 16) | client_addr.sin_port,
+                .fd = io_result
+        });
 
-        ASYNC_CONTINUE_OP(acceptClient);
+        AWAIT_LOOP(acceptClient);
 
         return TASK_RESULT_NONE();
     }
@@ -76,10 +152,13 @@ private:
     AIOUring *aioUring{nullptr};
     int tcpListeningPort{-1};
     int maxBacklogConnections{-1};
+    bool multishotAccept{false};
     sockaddr_in serviceAddr{};
     sockaddr_in client_addr{};
     socklen_t sockaddr_in_len =
             sizeof(struct sockaddr_in);
     int tcpSocket{-1};
+    int fileSlot{-1};
+    int acceptedSocket{-1};
 };
 #endif //AIOURING_TCPLISTENINGTASK_HPP
@@ -0,0 +1,171 @@
+#ifndef AIOURING_TCPSPLICESINKTASK_HPP
+#define AIOURING_TCPSPLICESINKTASK_HPP
+
+#include "aiouring/AIOUring.h"
+#include <aioutils/uexcept.h>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+
+using namespace aioutils;
+
+/**
+ * TCPSinkTask which moves the data socket -> pipe -> socket with splice, the bytes never
+ * reach userspace. The pipe comes from the pool of the ring. Splice always runs in an io-wq
+ * worker and SPLICE_F_NONBLOCK covers only the pipe side, so plain sockets are switched to
+ * O_NONBLOCK and the task waits for them with Poll on -EAGAIN. A registered socket can't be
+ * switched, it is polled before each splice. Either way an idle connection doesn't hold a
+ * worker thread.
+ */
+template<int ChunkSize = 262144>
+class TCPSpliceSinkTask final : public AIOUringTask {
+public:
+    explicit TCPSpliceSinkTask(AIOUring *aioUring, int tcpFrom, int tcpTo,
+                               std::optional<AIOUringTaskRef> notifyTask = std::nullopt)
+            : aioUring(aioUring), tcpFrom(tcpFrom),
+              tcpTo(tcpTo), notifyTask(notifyTask) {}
+
+    TaskFuture poll(int io_result) override {
+        ASYNC_IO;
+
+        pipe = aioUring->acquirePipe();
+
+        if(!pipe.has_value()) {
+            return TASK_ERROR_WITH_CODE(-errno, "Error on pipe: {}", strerror(errno));
+        }
+
+        setNonBlocking(tcpFrom);
+        setNonBlocking(tcpTo);
+
+        ASYNC_LOOP(spliceChunk);
+
+        if(AIOUringOp::isDirectFd(tcpFrom)) {
+            AWAIT_OP(Poll, pollFromFirst, tcpFrom, POLLIN);
+
+            if(io_result == -ECANCELED) {
+                return TASK_RESULT_NONE();
+            }
+
+            if(io_result < 0) {
+                return TASK_ERROR_WITH_CODE(io_result, "Error on tcp poll: {}", strerror(-io_result));
+            }
+        }
+
+        AWAIT_OP(Splice, spliceFrom, tcpFrom, pipe->writeFd, ChunkSize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        if(io_result == -EAGAIN) {
+            AWAIT_OP(Poll, pollFrom, tcpFrom, POLLIN);
+
+            if(io_result < 0 && io_result != -ECANCELED) {
+                return TASK_ERROR_WITH_CODE(io_result, "Error on tcp poll: {}", strerror(-io_result));
+            }
+
+            if(io_result >= 0) {
+                AWAIT_LOOP(spliceChunk);
+            }
+        }
+
+        if(io_result == -ECANCELED) {
+            // the other direction is done
+            return TASK_RESULT_NONE();
+        }
+
+        if(io_result < 0) {
+            return TASK_ERROR_WITH_CODE(io_result, "Error on tcp splice: {}", strerror(-io_result));
+        }
+
+        if(io_result == 0) {
+            // socket closed
+            return TASK_RESULT_NONE();
+        }
+
+        bytesInPipe = io_result;
+
+        ASYNC_LOOP(drainPipe);
+
+        if(AIOUringOp::isDirectFd(tcpTo)) {
+            AWAIT_OP(Poll, pollToFirst, tcpTo, POLLOUT);
+
+            if(io_result == -ECANCELED) {
+                return TASK_RESULT_NONE();
+            }
+
+            if(io_result < 0) {
+                return TASK_ERROR_WITH_CODE(io_result, "Error on tcp poll: {}", strerror(-io_result));
+            }
+        }
+
+        AWAIT_OP(Splice, spliceTo, pipe->readFd, tcpTo, bytesInPipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        if(io_result == -EAGAIN) {
+            AWAIT_OP(Poll, pollTo, tcpTo, POLLOUT);
+
+            if(io_result < 0 && io_result != -ECANCELED) {
+                return TASK_ERROR_WITH_CODE(io_result, "Error on tcp poll: {}", strerror(-io_result));
+            }
+
+            if(io_result >= 0) {
+                AWAIT_LOOP(drainPipe);
+            }
+        }
+
+        if(io_result == -ECANCELED) {
+            // the other direction is done
+            return TASK_RESULT_NONE();
+        }
+
+        if(io_result < 0) {
+            return TASK_ERROR_WITH_CODE(io_result, "Error on tcp splice: {}", strerror(-io_result));
+        }
+
+        if(io_result == 0) {
+            return TASK_ERROR("Error on tcp splice: {} bytes stuck in the pipe", bytesInPipe);
+        }
+
+        bytesInPipe -= io_result;
+
+        if(bytesInPipe > 0) {
+            AWAIT_LOOP(drainPipe);
+        }
+
+        AWAIT_LOOP(spliceChunk);
+
+        return TASK_RESULT_NONE();
+    }
+
+    TaskFuture finally(int io_result) override {
+        if(notifyTask.has_value()) {
+            aioUring->wake(*notifyTask);
+        }
+        return TASK_RESULT_NONE();
+    }
+
+    void free() override {
+        AIOUringTask::free();
+
+        if(pipe.has_value()) {
+            aioUring->releasePipe(*pipe, bytesInPipe == 0);
+        }
+    }
+private:
+    static void setNonBlocking(int fd) {
+        if(AIOUringOp::isDirectFd(fd)) {
+            return;
+        }
+
+        int flags = fcntl(fd, F_GETFL);
+
+        if(flags >= 0 && !(flags & O_NONBLOCK)) {
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+    }
+
+    AIOUring *aioUring{};
+    int tcpFrom{};
+    int tcpTo{};
+    std::optional<AIOUringTaskRef> notifyTask{};
+    std::optional<AIOUringPipe> pipe{};
+    int bytesInPipe{};
+};
+
+#endif //AIOURING_TCPSPLICESINKTASK_HPP
@@ -7,6 +7,7 @@
 
 #include "aiouring/AIOUring.h"
 #include <aioutils/uexcept.h>
+#include <cstring>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-label"
@@ -28,7 +29,7 @@ public:
         AWAIT_OP(Write, writeTo, tcpSocket, data + offset, size);
 
         if(io_result < 0) {
-            return TASK_ERROR(fmt::format("Error on tcp write: {}", uexcept::errnoStr(-io_result)));
+            return TASK_ERROR_WITH_CODE(io_result, "Error on tcp write: {}", strerror(-io_result));
         }
 
         if(io_result < size) {
@@ -0,0 +1,73 @@
+#ifndef AIOURING_TCPWRITEV_HPP
+#define AIOURING_TCPWRITEV_HPP
+
+#include "aiouring/AIOUring.h"
+#include <aioutils/uexcept.h>
+#include <cstring>
+#include <climits>
+#include <vector>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-label"
+#pragma ide diagnostic ignored "UnreachableCode"
+
+using namespace aioutils;
+
+/**
+ * Writes the pieces as one stream without gluing them into a single buffer. The buffers the
+ * iovecs point to must live until the task is done, the iovecs are copied.
+ */
+class TCPWritev final : public AIOUringTask {
+public:
+    explicit TCPWritev(int tcpSocket, std::vector<iovec> iovecs) :
+            tcpSocket(tcpSocket), iovecs(std::move(iovecs)) {}
+    TaskFuture poll(int io_result) override {
+        ASYNC_IO;
+
+        skipWritten(0);
+
+        if(index >= iovecs.size()) {
+            return TASK_RESULT_NONE();
+        }
+
+        AWAIT_OP(Writev, writeTo, tcpSocket, iovecs.data() + index,
+                 static_cast<unsigned>(std::min<size_t>(iovecs.size() - index, IOV_MAX)));
+
+        if(io_result < 0) {
+            return TASK_ERROR_WITH_CODE(io_result, "Error on tcp writev: {}", strerror(-io_result));
+        }
+
+        if(io_result == 0) {
+            return TASK_ERROR("Error on tcp writev: nothing written");
+        }
+
+        skipWritten(static_cast<size_t>(io_result));
+
+        if(index < iovecs.size()) {
+            AWAIT_POLL();
+        }
+
+        return TASK_RESULT_NONE();
+    }
+private:
+    int tcpSocket{-1};
+    std::vector<iovec> iovecs{};
+    size_t index{0};
+
+    // drops the written bytes, a partially written iovec is cut from the front
+    void skipWritten(size_t written) {
+        while(index < iovecs.size() && written >= iovecs[index].iov_len) {
+            written -= iovecs[index].iov_len;
+            ++index;
+        }
+
+        if(index < iovecs.size()) {
+            iovecs[index].iov_base = static_cast<char *>(iovecs[index].iov_base) + written;
+            iovecs[index].iov_len -= written;
+        }
+    }
+};
+
+#pragma clang diagnostic pop
+
+#endif //AIOURING_TCPWRITEV_HPP